@@ -1,332 +1,6279 @@
-// numberGuessing.cpp
-// Advanced Number Guessing Game - in a single-file C++17
-
-#include <iostream>
-#include <random>
-#include <chrono>
-#include <string>
-#include <limits>
-#include <fstream>
-#include <vector>
-#include <algorithm>
-#include <sstream>
-#include <iomanip>
-#include <ctime>
-#include <cmath>
-#include <cctype>
-
-using namespace std;
-using Clock = chrono::steady_clock;
-
-struct GameConfig {
-    string difficultyName = "Custom";
-    int minValue = 1;
-    int maxValue = 100;
-    int maxAttempts = 0; // 0 means unlimited
-};
-
-struct Result {
-    string playerName;
-    string difficulty;
-    int attempts;
-    double elapsedSeconds;
-    int secretNumber;
-    double score;
-    string timestamp;
-};
-
-// ---------- Utility helpers ----------
-string now_iso8601() {
-    auto now = chrono::system_clock::now();
-    time_t t = chrono::system_clock::to_time_t(now);
-
-    tm tm_buf{};
-    tm *tmp = std::localtime(&t);   // universally supported (not thread-safe)
-
-    if (tmp)
-        tm_buf = *tmp;
-    else
-        tm_buf = tm();  // fallback zero init
-
-    char buf[64];
-    strftime(buf, sizeof(buf), "%Y-%m-%d %H:%M:%S", &tm_buf);
-    return string(buf);
-}
-
-// Read line safely
-string safe_getline() {
-    string s;
-    getline(cin, s);
-    return s;
-}
-
-// Prompt and get integer with validation
-int prompt_int(const string &prompt, int minAllowed = numeric_limits<int>::min(), int maxAllowed = numeric_limits<int>::max()) {
-    while (true) {
-        cout << prompt;
-        cout.flush(); // ensure prompt appears immediately
-        string line;
-        if (!getline(cin, line)) {
-            // EOF or error
-            cout << "\nInput error. Exiting.\n";
-            exit(0);
-        }
-        // trim
-        auto start = line.find_first_not_of(" \t\r\n");
-        if (start == string::npos) { cout << "Please enter a value.\n"; continue; }
-        auto end = line.find_last_not_of(" \t\r\n");
-        string trimmed = line.substr(start, end - start + 1);
-        try {
-            size_t idx = 0;
-            long long val = stoll(trimmed, &idx);
-            if (idx != trimmed.size()) throw invalid_argument("extra chars");
-            if (val < minAllowed || val > maxAllowed) {
-                cout << "Enter a number between " << minAllowed << " and " << maxAllowed << ".\n";
-                continue;
-            }
-            return static_cast<int>(val);
-        } catch (...) {
-            cout << "Invalid input. Please enter an integer.\n";
-        }
-    }
-}
-
-// Prompt yes/no
-bool prompt_yesno(const string &prompt) {
-    while (true) {
-        cout << prompt << " (y/n): ";
-        cout.flush(); // ensure prompt appears immediately
-        string line;
-        if (!getline(cin, line)) exit(0);
-        if (line.empty()) continue;
-        // find first non-space char
-        size_t i = line.find_first_not_of(" \t\r\n");
-        if (i == string::npos) continue;
-        char c = static_cast<char>(tolower(static_cast<unsigned char>(line[i])));
-        if (c == 'y') return true;
-        if (c == 'n') return false;
-        cout << "Please reply with 'y' or 'n'.\n";
-    }
-}
-
-// ---------- Leaderboard persistence ----------
-const string LEADERBOARD_FILE = "leaderboard.csv";
-
-void append_to_leaderboard(const Result &r) {
-    ofstream ofs(LEADERBOARD_FILE, ios::app);
-    if (!ofs) {
-        cerr << "Warning: could not write leaderboard file.\n";
-        return;
-    }
-    // CSV: timestamp,player,difficulty,attempts,seconds,secret,score
-    ofs << "\"" << r.timestamp   << "\","
-        << "\"" << r.playerName  << "\","
-        << "\"" << r.difficulty  << "\","
-        << r.attempts            << ","
-        << fixed << setprecision(2) << r.elapsedSeconds << ","
-        << r.secretNumber        << ","
-        << fixed << setprecision(2) << r.score << "\n";
-}
-
-vector<Result> read_leaderboard(int limit = 10) {
-    vector<Result> out;
-    ifstream ifs(LEADERBOARD_FILE);
-    if (!ifs) return out;
-    string line;
-    while (getline(ifs, line)) {
-        if (line.empty()) continue;
-        // crude CSV parse (we wrote with quotes for strings)
-        stringstream ss(line);
-        string item;
-        Result r;
-        // timestamp
-        if (!getline(ss, item, ',')) continue;
-        if (item.size() >= 2 && item.front() == '"') item = item.substr(1, item.size()-2);
-        r.timestamp = item;
-        // player
-        if (!getline(ss, item, ',')) continue;
-        if (item.size() >= 2 && item.front() == '"') item = item.substr(1, item.size()-2);
-        r.playerName = item;
-        // difficulty
-        if (!getline(ss, item, ',')) continue;
-        if (item.size() >= 2 && item.front() == '"') item = item.substr(1, item.size()-2);
-        r.difficulty = item;
-        // attempts
-        if (!getline(ss, item, ',')) continue; r.attempts = stoi(item);
-        // seconds
-        if (!getline(ss, item, ',')) continue; r.elapsedSeconds = stod(item);
-        // secret
-        if (!getline(ss, item, ',')) continue; r.secretNumber = stoi(item);
-        // score
-        if (!getline(ss, item, ',')) continue; r.score = stod(item);
-        out.push_back(r);
-        if ((int)out.size() >= limit) break;
-    }
-    return out;
-}
-
-void show_leaderboard(int n = 10) {
-    auto entries = read_leaderboard(n);
-    if (entries.empty()) { cout << "No leaderboard entries yet.\n"; return; }
-    cout << "\nTop " << entries.size() << " recent games:\n";
-    cout << left << setw(20) << "Time" << setw(15) << "Player" << setw(12) << "Diff" << setw(10) << "Att" << setw(10) << "Sec" << setw(10) << "Score" << '\n';
-    cout << string(80, '-') << '\n';
-    for (auto &e : entries) {
-        cout << setw(20) << e.timestamp << setw(15) << e.playerName << setw(12) << e.difficulty << setw(10) << e.attempts << setw(10) << fixed << setprecision(1) << e.elapsedSeconds << setw(10) << fixed << setprecision(2) << e.score << '\n';
-    }
-    cout << '\n';
-}
-
-// ---------- Game logic ----------
-// Create a random integer in [minv, maxv]
-// Use fast time-seeded mt19937 to avoid slow random_device on some Windows/MinGW setups
-int random_int(int minv, int maxv) {
-    static uint64_t seed = static_cast<uint64_t>(Clock::now().time_since_epoch().count());
-    static mt19937_64 gen(seed);
-    uniform_int_distribution<int> dist(minv, maxv);
-    return dist(gen);
-}
-
-// Score formula
-double compute_score(int attempts, double secondsElapsed, const GameConfig &cfg) {
-    double rangeSize = static_cast<double>(cfg.maxValue - cfg.minValue + 1);
-    double base = 1000.0 / log2(rangeSize + 1.0);
-    double attemptPenalty = 20.0 * (attempts - 1);
-    double timePenalty = secondsElapsed / 2.0;
-    double score = base - attemptPenalty - timePenalty;
-    if (cfg.maxAttempts > 0) {
-        double frac = static_cast<double>(attempts) / cfg.maxAttempts;
-        score *= (1.0 + max(0.0, 0.5 - frac));
-    }
-    if (score < 0) score = 0;
-    return score;
-}
-
-GameConfig choose_difficulty() {
-    cout << "Choose difficulty:\n";
-    cout << "  1) Easy   (1 - 20, unlimited attempts)\n";
-    cout << "  2) Medium (1 - 100, 10 attempts)\n";
-    cout << "  3) Hard   (1 - 1000, 12 attempts)\n";
-    cout << "  4) Custom\n";
-    int choice = prompt_int("Enter choice [1-4]: ", 1, 4);
-    GameConfig cfg;
-    switch (choice) {
-        case 1:
-            cfg.difficultyName = "Easy";
-            cfg.minValue = 1; cfg.maxValue = 20; cfg.maxAttempts = 0;
-            break;
-        case 2:
-            cfg.difficultyName = "Medium";
-            cfg.minValue = 1; cfg.maxValue = 100; cfg.maxAttempts = 10;
-            break;
-        case 3:
-            cfg.difficultyName = "Hard";
-            cfg.minValue = 1; cfg.maxValue = 1000; cfg.maxAttempts = 12;
-            break;
-        case 4:
-        default:
-            cfg.difficultyName = "Custom";
-            cout << "Enter minimum value: ";
-            cfg.minValue = prompt_int("", -1000000, 1000000);
-            cout << "Enter maximum value: ";
-            cfg.maxValue = prompt_int("", cfg.minValue+1, 1000000);
-            if (prompt_yesno("Would you like to set a maximum attempts limit?")) {
-                cfg.maxAttempts = prompt_int("Enter maximum attempts (>=1): ", 1, 1000000);
-            } else cfg.maxAttempts = 0;
-            break;
-    }
-    cout << "You selected: " << cfg.difficultyName << " (" << cfg.minValue << " - " << cfg.maxValue << ")";
-    if (cfg.maxAttempts > 0) cout << ", max attempts = " << cfg.maxAttempts;
-    cout << '\n';
-    return cfg;
-}
-
-Result play_game(const GameConfig &cfg) {
-    int secret = random_int(cfg.minValue, cfg.maxValue);
-    int attempts = 0;
-    int lowHint = cfg.minValue, highHint = cfg.maxValue;
-
-    cout << "\nI have selected a number between " << cfg.minValue << " and " << cfg.maxValue << ".\n";
-    if (cfg.maxAttempts > 0) cout << "You have up to " << cfg.maxAttempts << " attempts.\n";
-    cout << "Type your guess and press Enter.\n";
-
-    auto start = Clock::now();
-    while (true) {
-        cout << "Allowed range: [" << lowHint << " - " << highHint << "] ";
-        cout.flush(); // show prompt immediately
-        string prompt = "Enter guess (or 0 to give up): ";
-        int guess = prompt_int(prompt, numeric_limits<int>::min(), numeric_limits<int>::max());
-
-        if (guess == 0) {
-            cout << "You gave up. The number was " << secret << ".\n";
-            break;
-        }
-
-        attempts++;
-
-        if (guess == secret) {
-            cout << "Congratulations! You guessed correctly in " << attempts << " attempts.\n";
-            break;
-        } else if (guess > secret) {
-            cout << "Too high.\n";
-            if (guess - 1 < highHint) highHint = guess - 1;
-        } else {
-            cout << "Too low.\n";
-            if (guess + 1 > lowHint) lowHint = guess + 1;
-        }
-
-        if (cfg.maxAttempts > 0 && attempts >= cfg.maxAttempts) {
-            cout << "Reached maximum attempts (" << cfg.maxAttempts << "). You lose. The number was " << secret << ".\n";
-            break;
-        }
-    }
-    auto end = Clock::now();
-    double elapsed = chrono::duration_cast<chrono::duration<double>>(end - start).count();
-
-    Result res;
-    cout << "\nEnter your name for the leaderboard (leave blank to skip): ";
-    cout.flush();
-    string name = safe_getline();
-    if (name.empty()) name = "Anonymous";
-    res.playerName = name;
-    res.difficulty = cfg.difficultyName + " (" + to_string(cfg.minValue) + "-" + to_string(cfg.maxValue) + ")";
-    res.attempts = attempts;
-    res.elapsedSeconds = elapsed;
-    res.secretNumber = secret;
-    res.timestamp = now_iso8601();
-    res.score = compute_score(max(1, attempts), elapsed, cfg);
-
-    if (name != "Anonymous") append_to_leaderboard(res);
-    return res;
-}
-
-int main() {
-    ios::sync_with_stdio(false);
-    cin.tie(nullptr);
-
-    cout << "=== Advanced Number Guessing Game ===\n";
-    cout << "(Type CTRL+D or CTRL+Z to exit any time)\n\n";
-    cout.flush();
-
-    while (true) {
-        GameConfig cfg = choose_difficulty();
-        Result r = play_game(cfg);
-
-        cout << "\nGame summary:\n";
-        cout << " Player: " << r.playerName << '\n';
-        cout << " Difficulty: " << r.difficulty << '\n';
-        cout << " Attempts: " << r.attempts << '\n';
-        cout << " Time: " << fixed << setprecision(1) << r.elapsedSeconds << " seconds\n";
-        cout << " Score: " << fixed << setprecision(2) << r.score << "\n";
-
-        if (prompt_yesno("Would you like to view the recent leaderboard?")) {
-            show_leaderboard(10);
-        }
-
-        if (!prompt_yesno("Play again?")) break;
-        cout << "\n";
-    }
-
-    cout << "Thanks for playing! Goodbye.\n";
-    return 0;
-}
+// numberGuessing.cpp
+// Advanced Number Guessing Game - in a single-file C++17
+
+#include <iostream>
+#include <random>
+#include <chrono>
+#include <string>
+#include <string_view>
+#include <limits>
+#include <fstream>
+#include <vector>
+#include <algorithm>
+#include <sstream>
+#include <charconv>
+#include <iomanip>
+#include <ctime>
+#include <cmath>
+#include <cctype>
+#include <cstdint>
+#include <cstring>
+#include <array>
+#include <map>
+#include <memory>
+#include <type_traits>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <functional>
+#include <deque>
+#include <list>
+#include <utility>
+#include <sys/stat.h>
+#if defined(__cpp_impl_coroutine) && __has_include(<coroutine>)
+#include <coroutine>
+#define HAVE_COROUTINES 1
+#endif
+
+#include "numberGuessing.h"
+
+#ifdef __linux__
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <netinet/in.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <csignal>
+#include <unordered_map>
+#include <sys/uio.h>
+#include <sys/inotify.h>
+#include <poll.h>
+#include <termios.h>
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#define HAVE_IO_URING 1
+#endif
+#endif
+
+using namespace std;
+using Clock = chrono::steady_clock;
+
+enum class ScoringPolicy {
+    Standard, // attempts and time both count
+    Untimed   // no time penalty
+};
+
+// The engine is templated on the value type. Games whose range fits in an
+// int run on BasicGameConfig<int> (the original 32-bit code path); wider
+// Custom ranges run on BasicGameConfig<int64_t>.
+
+template <typename T>
+struct BasicGameConfig {
+    string difficultyName = "Custom";
+    T minValue = 1;
+    T maxValue = 100;
+    int maxAttempts = 0; // 0 means unlimited
+    int maxLies = 0;     // feedback may be a lie up to this many times
+    bool detectRepeats = false; // warn about repeated / out-of-window guesses
+    ScoringPolicy scoring = ScoringPolicy::Standard;
+    int timeLimitSeconds = 0;   // 0 means no time limit
+    bool adaptive = false;      // range and attempts picked by AdaptiveCoach
+    string playerName;          // known up front for adaptive games, else asked at the end
+
+    BasicGameConfig() = default;
+
+    // Narrowing/widening copy; callers check fits_in<U>() first
+    template <typename U>
+    explicit BasicGameConfig(const BasicGameConfig<U> &o)
+        : difficultyName(o.difficultyName), minValue(static_cast<T>(o.minValue)), maxValue(static_cast<T>(o.maxValue)),
+          maxAttempts(o.maxAttempts), maxLies(o.maxLies), detectRepeats(o.detectRepeats), scoring(o.scoring),
+          timeLimitSeconds(o.timeLimitSeconds), adaptive(o.adaptive), playerName(o.playerName) {}
+
+    template <typename U>
+    bool fits_in() const {
+        return static_cast<int64_t>(minValue) >= static_cast<int64_t>(numeric_limits<U>::min()) &&
+               static_cast<int64_t>(maxValue) <= static_cast<int64_t>(numeric_limits<U>::max());
+    }
+};
+
+using GameConfig = BasicGameConfig<int>;
+using WideGameConfig = BasicGameConfig<int64_t>;
+
+struct Result {
+    string playerName;
+    string difficulty;
+    int attempts;
+    double elapsedSeconds;
+    int64_t secretNumber;
+    double score;
+    string timestamp;
+    bool won = false;
+    uint64_t matchId = 0; // race mode only
+    int position = 0;     // finishing position in a race (1 = winner)
+    int repeats = 0;      // guesses made more than once (repeat detection only)
+    int outOfWindow = 0;  // guesses outside the known hint window
+};
+
+// ---------- Utility helpers ----------
+string now_iso8601() {
+    auto now = chrono::system_clock::now();
+    time_t t = chrono::system_clock::to_time_t(now);
+
+    tm tm_buf{};
+    tm *tmp = std::localtime(&t);   // universally supported (not thread-safe)
+
+    if (tmp)
+        tm_buf = *tmp;
+    else
+        tm_buf = tm();  // fallback zero init
+
+    char buf[64];
+    strftime(buf, sizeof(buf), "%Y-%m-%d %H:%M:%S", &tm_buf);
+    return string(buf);
+}
+
+// ---------- Console output ----------
+// A screen (a table, a prompt, a summary) is laid out in one buffer and
+// handed to cout with a single write and flush, instead of a formatted
+// insertion per field. Numbers go through to_chars, so no stream state is
+// read or changed.
+// `value` with `precision` decimals, exactly as printf("%.*f") writes it.
+// Up to 3 decimals, a value that is not within 1e-3 of a rounding tie once
+// scaled is rounded as an integer: below 1e12 the scaling error is under
+// 2e-4, so the rounding direction is certain. Ties, huge values and NaN/inf
+// go through to_chars. Returns the end of the text, or null if it does not fit.
+char *format_fixed(char *first, char *last, double value, int precision) {
+    static const double SCALE[] = {1, 10, 100, 1000};
+    if (precision >= 0 && precision <= 3 && isfinite(value)) {
+        double m = fabs(value) * SCALE[precision];
+        double whole = floor(m), frac = m - whole;
+        if (m < 1e12 && fabs(frac - 0.5) > 1e-3) {
+            char digits[24];
+            uint64_t units = static_cast<uint64_t>(whole) + (frac > 0.5 ? 1 : 0);
+            size_t n = static_cast<size_t>(to_chars(digits, digits + sizeof digits, units).ptr - digits);
+            size_t intDigits = n > static_cast<size_t>(precision) ? n - precision : 1;
+            size_t len = signbit(value) + intDigits + (precision ? 1 + precision : 0);
+            if (static_cast<size_t>(last - first) < len) return nullptr;
+            char *p = first;
+            if (signbit(value)) *p++ = '-'; // printf keeps the sign of -0.001 too
+            if (n > static_cast<size_t>(precision)) p = copy(digits, digits + intDigits, p);
+            else *p++ = '0';
+            if (precision) {
+                *p++ = '.';
+                size_t lead = n < static_cast<size_t>(precision) ? precision - n : 0;
+                p = fill_n(p, lead, '0');
+                p = copy(digits + n - (precision - lead), digits + n, p);
+            }
+            return p;
+        }
+    }
+    auto res = to_chars(first, last, value, chars_format::fixed, precision);
+    return res.ec == errc() ? res.ptr : nullptr;
+}
+
+class ConsoleWriter {
+public:
+    ConsoleWriter() { buf_.reserve(1024); }
+    ~ConsoleWriter() { flush(); }
+    ConsoleWriter(const ConsoleWriter &) = delete;
+    ConsoleWriter &operator=(const ConsoleWriter &) = delete;
+
+    ConsoleWriter &operator<<(string_view s) { buf_.append(s.data(), s.size()); return *this; }
+    ConsoleWriter &operator<<(char c) { buf_ += c; return *this; }
+
+    template <typename I, typename = enable_if_t<is_integral<I>::value>>
+    ConsoleWriter &operator<<(I value) {
+        char tmp[24];
+        buf_.append(tmp, to_chars(tmp, tmp + sizeof tmp, value).ptr);
+        return *this;
+    }
+
+    ConsoleWriter &fixed(double value, int precision) {
+        char tmp[64];
+        if (char *end = format_fixed(tmp, tmp + sizeof tmp, value, precision)) buf_.append(tmp, end);
+        else buf_ += to_string(value); // beyond 1e60 or so; never in practice
+        return *this;
+    }
+
+    // Left-aligned in `width` columns; longer text is not cut (like setw)
+    ConsoleWriter &pad(string_view s, size_t width) {
+        *this << s;
+        if (s.size() < width) buf_.append(width - s.size(), ' ');
+        return *this;
+    }
+
+    // Right-aligned in `width` columns
+    ConsoleWriter &pad_left(string_view s, size_t width) {
+        if (s.size() < width) buf_.append(width - s.size(), ' ');
+        return *this << s;
+    }
+
+    ConsoleWriter &repeat(char c, size_t n) { buf_.append(n, c); return *this; }
+
+    // Room for `n` more bytes, written directly by the caller
+    char *extend(size_t n) {
+        size_t at = buf_.size();
+        buf_.resize(at + n);
+        return &buf_[at];
+    }
+
+    const string &str() const { return buf_; }
+    void clear() { buf_.clear(); }
+
+    // The text so far, for a caller that sends it somewhere other than cout
+    string take() {
+        string s;
+        s.swap(buf_);
+        return s;
+    }
+
+    void flush() {
+        if (buf_.empty()) return;
+        cout.write(buf_.data(), static_cast<streamsize>(buf_.size()));
+        cout.flush();
+        buf_.clear();
+    }
+
+private:
+    string buf_;
+};
+
+// Writes whole lines for threads that share the console, such as the race
+// server's workers, writer and watchers. main turns off stdio sync, which
+// leaves cout and cerr unsafe to write from two threads at once, so every
+// such line goes out under one lock and is flushed before it is released.
+void log_line(string_view text, ostream &os = cout) {
+    static mutex consoleMutex;
+    lock_guard<mutex> lock(consoleMutex);
+    os.write(text.data(), static_cast<streamsize>(text.size()));
+    if (text.empty() || text.back() != '\n') os.put('\n');
+    os.flush();
+}
+
+// Left-aligned text table. Cells are appended row by row into one string,
+// and each column's width (at least its minimum, else its longest cell plus
+// a space) is kept up to date as cells arrive, so rendering is one pass.
+class TextTable {
+public:
+    struct Column {
+        string_view header;
+        size_t minWidth;
+    };
+
+    explicit TextTable(vector<Column> columns) : columns_(move(columns)), widths_(columns_.size()) {
+        for (size_t i = 0; i < columns_.size(); ++i) widths_[i] = max(columns_[i].minWidth, columns_[i].header.size() + 1);
+    }
+
+    void reserve(size_t rows) {
+        ends_.reserve(rows * columns_.size());
+        text_.reserve(rows * columns_.size() * 12);
+    }
+
+    TextTable &cell(string_view s) {
+        text_.append(s.data(), s.size());
+        return end_cell();
+    }
+
+    TextTable &cell(int64_t value) {
+        char tmp[24];
+        text_.append(tmp, to_chars(tmp, tmp + sizeof tmp, value).ptr);
+        return end_cell();
+    }
+
+    TextTable &cell(double value, int precision) {
+        char tmp[64];
+        if (char *end = format_fixed(tmp, tmp + sizeof tmp, value, precision)) text_.append(tmp, end);
+        return end_cell();
+    }
+
+    // Header, a rule at least `ruleWidth` wide, then the rows. Every width is
+    // known by now, so the rows are sized once and copied straight in.
+    void render(ConsoleWriter &out, size_t ruleWidth) const {
+        size_t total = 0;
+        for (size_t i = 0; i < columns_.size(); ++i) {
+            out.pad(columns_[i].header, widths_[i]);
+            total += widths_[i];
+        }
+        out << '\n';
+        out.repeat('-', max(ruleWidth, total)) << '\n';
+
+        // non-last cells are padded to their width (always wider than the
+        // text); the last cell ends the line unpadded
+        size_t rows = ends_.size() / columns_.size();
+        char *p = out.extend(rows * (total - widths_.back() + 1) + lastColumnBytes_);
+        size_t begin = 0, col = 0;
+        for (size_t i = 0; i < rows * columns_.size(); ++i) {
+            size_t end = ends_[i];
+            p = copy(text_.data() + begin, text_.data() + end, p);
+            if (++col == columns_.size()) {
+                *p++ = '\n';
+                col = 0;
+            } else {
+                p = fill_n(p, widths_[col - 1] - (end - begin), ' ');
+            }
+            begin = end;
+        }
+    }
+
+private:
+    TextTable &end_cell() {
+        size_t len = text_.size() - (ends_.empty() ? 0 : ends_.back());
+        widths_[col_] = max(widths_[col_], len + 1);
+        ends_.push_back(text_.size());
+        if (++col_ == columns_.size()) {
+            lastColumnBytes_ += len;
+            col_ = 0;
+        }
+        return *this;
+    }
+
+    vector<Column> columns_;
+    vector<size_t> widths_;
+    string text_;
+    vector<size_t> ends_;
+    size_t col_ = 0;
+    size_t lastColumnBytes_ = 0; // complete rows only
+};
+
+// Read line safely
+string safe_getline() {
+    string s;
+    getline(cin, s);
+    return s;
+}
+
+// Wait until the player finishes a line or `deadline` passes; false on
+// timeout. Only a terminal is waited on: it hands over input a line at a
+// time, while piped input may already sit in stdin's buffer where poll()
+// cannot see it, so there the caller checks the clock after reading.
+bool wait_for_line(Clock::time_point deadline) {
+#ifdef __linux__
+    if (deadline == Clock::time_point::max() || !isatty(STDIN_FILENO)) return true;
+    while (true) {
+        auto left = deadline - Clock::now();
+        if (left <= Clock::duration::zero()) {
+            tcflush(STDIN_FILENO, TCIFLUSH); // a half-typed guess must not answer the next prompt
+            return false;
+        }
+        pollfd p{STDIN_FILENO, POLLIN, 0};
+        int n = poll(&p, 1, static_cast<int>(chrono::duration_cast<chrono::milliseconds>(left).count()) + 1);
+        if (n > 0 || (n < 0 && errno != EINTR)) return true; // getline reports any error
+    }
+#else
+    (void)deadline; // checked by the caller once the line is in
+    return true;
+#endif
+}
+
+// Prompt and get integer with validation. With allowQuit, typing q (or
+// quit) returns false instead, so no number has to be reserved for giving up.
+// Also returns false if `deadline` passes while waiting for input.
+template <typename T>
+bool read_value(const string &prompt, T minAllowed, T maxAllowed, bool allowQuit, T &out,
+                Clock::time_point deadline = Clock::time_point::max()) {
+    while (true) {
+        cout << prompt;
+        cout.flush(); // ensure prompt appears immediately
+        if (!wait_for_line(deadline)) {
+            cout << '\n';
+            return false;
+        }
+        string line;
+        if (!getline(cin, line)) {
+            // EOF or error
+            cout << "\nInput error. Exiting.\n";
+            exit(0);
+        }
+        // trim
+        auto start = line.find_first_not_of(" \t\r\n");
+        if (start == string::npos) { cout << "Please enter a value.\n"; continue; }
+        auto end = line.find_last_not_of(" \t\r\n");
+        string trimmed = line.substr(start, end - start + 1);
+        if (allowQuit && (trimmed == "q" || trimmed == "Q" || trimmed == "quit")) return false;
+        try {
+            size_t idx = 0;
+            long long val = stoll(trimmed, &idx);
+            if (idx != trimmed.size()) throw invalid_argument("extra chars");
+            if (val < minAllowed || val > maxAllowed) {
+                cout << "Enter a number between " << minAllowed << " and " << maxAllowed << ".\n";
+                continue;
+            }
+            out = static_cast<T>(val);
+            return true;
+        } catch (...) {
+            cout << "Invalid input. Please enter an integer" << (allowQuit ? " (or q to give up).\n" : ".\n");
+        }
+    }
+}
+
+template <typename T>
+T prompt_value(const string &prompt, T minAllowed = numeric_limits<T>::min(), T maxAllowed = numeric_limits<T>::max()) {
+    T value{};
+    read_value(prompt, minAllowed, maxAllowed, false, value);
+    return value;
+}
+
+// A guess in [minAllowed, maxAllowed], or false if the player gave up or
+// ran out of time
+template <typename T>
+bool prompt_guess(const string &prompt, T minAllowed, T maxAllowed, T &guess, Clock::time_point deadline) {
+    return read_value(prompt, minAllowed, maxAllowed, true, guess, deadline);
+}
+
+// When a game with a time limit started at `start` runs out
+Clock::time_point game_deadline(Clock::time_point start, int timeLimitSeconds) {
+    return timeLimitSeconds > 0 ? start + chrono::seconds(timeLimitSeconds) : Clock::time_point::max();
+}
+
+int prompt_int(const string &prompt, int minAllowed = numeric_limits<int>::min(), int maxAllowed = numeric_limits<int>::max()) {
+    return prompt_value<int>(prompt, minAllowed, maxAllowed);
+}
+
+// Prompt for a single-letter reply out of `allowed` (case-insensitive)
+char prompt_choice(const string &prompt, const string &allowed) {
+    while (true) {
+        cout << prompt;
+        cout.flush(); // ensure prompt appears immediately
+        string line;
+        if (!getline(cin, line)) exit(0);
+        size_t i = line.find_first_not_of(" \t\r\n");
+        if (i == string::npos) continue;
+        char c = static_cast<char>(tolower(static_cast<unsigned char>(line[i])));
+        if (allowed.find(c) != string::npos) return c;
+        cout << "Please reply with one of: " << allowed << ".\n";
+    }
+}
+
+// Prompt yes/no
+bool prompt_yesno(const string &prompt) {
+    while (true) {
+        cout << prompt << " (y/n): ";
+        cout.flush(); // ensure prompt appears immediately
+        string line;
+        if (!getline(cin, line)) exit(0);
+        if (line.empty()) continue;
+        // find first non-space char
+        size_t i = line.find_first_not_of(" \t\r\n");
+        if (i == string::npos) continue;
+        char c = static_cast<char>(tolower(static_cast<unsigned char>(line[i])));
+        if (c == 'y') return true;
+        if (c == 'n') return false;
+        cout << "Please reply with 'y' or 'n'.\n";
+    }
+}
+
+// ---------- Leaderboard persistence ----------
+const string LEADERBOARD_FILE = "leaderboard.csv";
+
+// Identity of the leaderboard file as it was when the shared copy was
+// built, so a stale copy can be noticed; all zero while the file is missing
+struct CsvStamp {
+    uint64_t device = 0, inode = 0, size = 0;
+    bool operator==(const CsvStamp &o) const { return device == o.device && inode == o.inode && size == o.size; }
+    bool operator!=(const CsvStamp &o) const { return !(*this == o); }
+};
+
+CsvStamp leaderboard_stamp() {
+    CsvStamp stamp;
+    struct stat st;
+    if (stat(LEADERBOARD_FILE.c_str(), &st) == 0) {
+        stamp.device = static_cast<uint64_t>(st.st_dev);
+        stamp.inode = static_cast<uint64_t>(st.st_ino);
+        stamp.size = static_cast<uint64_t>(st.st_size);
+    }
+    return stamp;
+}
+
+// `before` is the file's stamp from just before the batch was appended.
+// Defined with SharedLeaderboard below.
+void publish_to_shared_leaderboard(const vector<Result> &batch, const CsvStamp &before);
+
+// CSV: timestamp,player,difficulty,attempts,seconds,secret,score
+//
+// Rows are formatted with to_chars into a caller's buffer: no stream state,
+// no locale and no allocation. Strings are quoted with embedded quotes
+// doubled (RFC 4180); seconds and score get two decimals, as printf("%.2f")
+// would write them.
+constexpr size_t LEADERBOARD_ROW_BUFFER = 512; // fits any row with names under ~150 bytes
+
+// Bytes a row can need at most: every name character a quote, doubles near DBL_MAX
+size_t leaderboard_row_bound(const Result &r) {
+    return 2 * (r.timestamp.size() + r.playerName.size() + r.difficulty.size()) + 6 + 7 +
+           numeric_limits<int>::digits10 + 2 + numeric_limits<int64_t>::digits10 + 2 +
+           2 * (numeric_limits<double>::max_exponent10 + 5);
+}
+
+char *put_csv_quoted(char *p, char *end, const string &s) {
+    if (p == end) return nullptr;
+    *p++ = '"';
+    for (char ch : s) {
+        if (end - p < 2) return nullptr;
+        if (ch == '"') *p++ = '"';
+        *p++ = ch;
+    }
+    if (end - p < 2) return nullptr;
+    *p++ = '"';
+    *p++ = ',';
+    return p;
+}
+
+template <typename V, typename... Format>
+char *put_csv_number(char *p, char *end, V value, char sep, Format... format) {
+    if (!p) return nullptr;
+    auto res = to_chars(p, end, value, format...);
+    if (res.ec != errc() || res.ptr == end) return nullptr;
+    *res.ptr = sep;
+    return res.ptr + 1;
+}
+
+// Format `r` into buf; returns the row length, or 0 if it does not fit in `size` bytes
+size_t format_leaderboard_row(const Result &r, char *buf, size_t size) {
+    char *p = buf, *end = buf + size;
+    p = put_csv_quoted(p, end, r.timestamp);
+    if (p) p = put_csv_quoted(p, end, r.playerName);
+    if (p) p = put_csv_quoted(p, end, r.difficulty);
+    p = put_csv_number(p, end, r.attempts, ',');
+    p = put_csv_number(p, end, r.elapsedSeconds, ',', chars_format::fixed, 2);
+    p = put_csv_number(p, end, r.secretNumber, ',');
+    p = put_csv_number(p, end, r.score, '\n', chars_format::fixed, 2);
+    return p ? static_cast<size_t>(p - buf) : 0;
+}
+
+// Calls out(data, len) with the formatted row; only oversized names leave the stack
+template <typename Out>
+void with_leaderboard_row(const Result &r, Out out) {
+    char buf[LEADERBOARD_ROW_BUFFER];
+    if (size_t n = format_leaderboard_row(r, buf, sizeof buf)) return out(buf, n);
+    vector<char> big(leaderboard_row_bound(r));
+    out(big.data(), format_leaderboard_row(r, big.data(), big.size()));
+}
+
+void write_leaderboard_row(ostream &os, const Result &r) {
+    with_leaderboard_row(r, [&](const char *data, size_t n) { os.write(data, static_cast<streamsize>(n)); });
+}
+
+void append_leaderboard_row(string &out, const Result &r) {
+    with_leaderboard_row(r, [&](const char *data, size_t n) { out.append(data, n); });
+}
+
+// Returns false if the file could not be written; callers decide whether
+// to warn (the library interface must stay silent)
+bool append_to_leaderboard(const vector<Result> &batch) {
+    static mutex writeMutex; // server workers append concurrently
+    lock_guard<mutex> lock(writeMutex);
+    CsvStamp before = leaderboard_stamp();
+    ofstream ofs(LEADERBOARD_FILE, ios::app);
+    if (!ofs) return false;
+    for (auto &r : batch) write_leaderboard_row(ofs, r);
+    ofs.close();
+    if (!ofs) return false;
+    publish_to_shared_leaderboard(batch, before);
+    return true;
+}
+
+void append_to_leaderboard(const Result &r) {
+    if (!append_to_leaderboard(vector<Result>{r})) cerr << "Warning: could not write leaderboard file.\n";
+}
+
+// Next comma-separated field of `line` from `pos`, unquoting "..." fields
+bool next_csv_field(const string &line, size_t &pos, string &out) {
+    if (pos > line.size()) return false;
+    out.clear();
+    if (pos < line.size() && line[pos] == '"') {
+        for (++pos; pos < line.size(); ++pos) {
+            if (line[pos] != '"') out += line[pos];
+            else if (pos + 1 < line.size() && line[pos + 1] == '"') out += line[++pos];
+            else { ++pos; break; }
+        }
+    }
+    size_t comma = line.find(',', pos);
+    if (comma == string::npos) comma = line.size();
+    out.append(line, pos, comma - pos);
+    pos = comma + 1;
+    return true;
+}
+
+// Parse one leaderboard line; false for blank, short or malformed rows
+bool parse_leaderboard_row(const string &line, Result &r) {
+    if (line.empty() || line == "\r") return false;
+    size_t pos = 0;
+    string item;
+    if (!next_csv_field(line, pos, r.timestamp)) return false;
+    if (!next_csv_field(line, pos, r.playerName)) return false;
+    if (!next_csv_field(line, pos, r.difficulty)) return false;
+    try {
+        if (!next_csv_field(line, pos, item)) return false;
+        r.attempts = stoi(item);
+        if (!next_csv_field(line, pos, item)) return false;
+        r.elapsedSeconds = stod(item);
+        if (!next_csv_field(line, pos, item)) return false;
+        r.secretNumber = stoll(item);
+        if (!next_csv_field(line, pos, item)) return false;
+        r.score = stod(item);
+    } catch (...) {
+        return false;
+    }
+    return true;
+}
+
+// The last `limit` games in the file, oldest first
+vector<Result> read_leaderboard(int limit = 10) {
+    deque<Result> out;
+    ifstream ifs(LEADERBOARD_FILE);
+    if (!ifs) return {};
+    string line;
+    while (getline(ifs, line)) {
+        Result r;
+        if (!parse_leaderboard_row(line, r)) continue;
+        out.push_back(move(r));
+        if ((int)out.size() > limit) out.pop_front();
+    }
+    return vector<Result>(make_move_iterator(out.begin()), make_move_iterator(out.end()));
+}
+
+// --bench-csv: leaderboard rows per second through the stream manipulators
+// the file used to be written with, against format_leaderboard_row
+void run_csv_benchmark(int rows) {
+    auto legacy = [](ostream &os, const Result &r) {
+        os << "\"" << r.timestamp << "\"," << "\"" << r.playerName << "\"," << "\"" << r.difficulty << "\","
+           << r.attempts << "," << fixed << setprecision(2) << r.elapsedSeconds << "," << r.secretNumber << ","
+           << fixed << setprecision(2) << r.score << "\n";
+    };
+    mt19937_64 gen(7);
+    vector<Result> sample(4096);
+    for (auto &r : sample) {
+        r.timestamp = "2025-01-10 18:21:33";
+        r.playerName = "Player" + to_string(gen() % 1000);
+        r.difficulty = gen() % 2 ? "Medium (1-100)" : "Custom (-5000000000-5000000000)";
+        r.attempts = static_cast<int>(gen() % 40) + 1;
+        r.elapsedSeconds = static_cast<double>(gen() % 1000000) / 1000.0; // includes exact .xx5 ties
+        r.secretNumber = static_cast<int64_t>(gen()) / 2;
+        r.score = static_cast<double>(gen() % 4000000) / 3000.0;
+    }
+
+    auto time_rows = [&](auto &&format) {
+        auto start = Clock::now();
+        for (int i = 0; i < rows; ++i) format(sample[i & (sample.size() - 1)]);
+        return rows / chrono::duration<double>(Clock::now() - start).count() / 1e6;
+    };
+    ostringstream streamOut;
+    double streamRate = time_rows([&](const Result &r) {
+        if (streamOut.tellp() > (1 << 20)) streamOut.str("");
+        legacy(streamOut, r);
+    });
+    string charsOut;
+    charsOut.reserve(2 << 20);
+    double charsRate = time_rows([&](const Result &r) {
+        if (charsOut.size() > (1 << 20)) charsOut.clear();
+        append_leaderboard_row(charsOut, r);
+    });
+
+    ostringstream a;
+    string b;
+    for (auto &r : sample) { legacy(a, r); append_leaderboard_row(b, r); }
+    ConsoleWriter out;
+    out << "Leaderboard rows (" << rows << " rows, output " << (a.str() == b ? "identical" : "DIFFERS") << "):\n";
+    out << "  ostream manipulators: ";
+    out.fixed(streamRate, 2) << " M rows/s\n";
+    out << "  to_chars serializer:  ";
+    out.fixed(charsRate, 2) << " M rows/s\n";
+}
+
+// ---------- Shared-memory leaderboard ----------
+// Console games on one host share a POSIX shared-memory copy of the
+// leaderboard: the top TOP_N games per difficulty plus a ring of the last
+// RECENT_N games. The region records the device, inode and size of the
+// leaderboard.csv it was built from. Every append updates the region along
+// with that size, and show_leaderboard renders from it without reading the
+// file. When the file no longer matches the record, the region is rebuilt
+// from the file. That covers a fresh region, a file that was edited,
+// truncated or replaced, and a process that died halfway through a rebuild.
+//
+// Writers serialise on a spinlock holding the owner's pid, so a lock left by
+// a dead process can be taken over. They bump a sequence counter around each
+// update (odd while writing). Readers copy the data and retry if the counter
+// was odd or changed meanwhile, so they never block writers. The region name
+// includes a hash of the working directory, so games using different
+// leaderboard files do not share a region.
+struct BoardEntry {
+    char timestamp[20];
+    char player[32];
+    char difficulty[32];
+    int32_t attempts;
+    double seconds;
+    int64_t secret;
+    double score;
+};
+
+struct BoardData {
+    static constexpr uint32_t TOP_N = 10;
+    static constexpr uint32_t MAX_DIFFICULTIES = 16;
+    static constexpr uint32_t RECENT_N = 64;
+
+    struct Top {
+        char difficulty[32];
+        uint32_t count;
+        BoardEntry entries[TOP_N]; // best score first
+    };
+
+    uint32_t topCount;
+    uint32_t recentCount;
+    uint32_t recentHead;        // next slot to overwrite
+    Top tops[MAX_DIFFICULTIES];
+    BoardEntry recent[RECENT_N];
+
+    void add(const BoardEntry &e) {
+        recent[recentHead] = e;
+        recentHead = (recentHead + 1) % RECENT_N;
+        if (recentCount < RECENT_N) recentCount++;
+
+        Top *top = nullptr;
+        for (uint32_t i = 0; i < topCount && !top; ++i)
+            if (strncmp(tops[i].difficulty, e.difficulty, sizeof e.difficulty) == 0) top = &tops[i];
+        if (!top) {
+            if (topCount == MAX_DIFFICULTIES) return; // still listed under recent games
+            top = &tops[topCount++];
+            memcpy(top->difficulty, e.difficulty, sizeof top->difficulty);
+            top->count = 0;
+        }
+        uint32_t pos = top->count;
+        while (pos > 0 && top->entries[pos - 1].score < e.score) --pos;
+        if (pos == TOP_N) return;
+        uint32_t last = min(top->count, TOP_N - 1);
+        for (uint32_t i = last; i > pos; --i) top->entries[i] = top->entries[i - 1];
+        top->entries[pos] = e;
+        if (top->count < TOP_N) top->count++;
+    }
+
+    // Recent games, oldest first
+    vector<BoardEntry> recent_games() const {
+        vector<BoardEntry> out;
+        uint32_t first = (recentHead + RECENT_N - recentCount) % RECENT_N;
+        for (uint32_t i = 0; i < recentCount; ++i) out.push_back(recent[(first + i) % RECENT_N]);
+        return out;
+    }
+};
+
+BoardEntry board_entry(const Result &r) {
+    BoardEntry e{};
+    strncpy(e.timestamp, r.timestamp.c_str(), sizeof e.timestamp - 1);
+    strncpy(e.player, r.playerName.c_str(), sizeof e.player - 1);
+    strncpy(e.difficulty, r.difficulty.c_str(), sizeof e.difficulty - 1);
+    e.attempts = r.attempts;
+    e.seconds = r.elapsedSeconds;
+    e.secret = r.secretNumber;
+    e.score = r.score;
+    return e;
+}
+
+Result result_from_entry(const BoardEntry &e) {
+    Result r;
+    r.timestamp = e.timestamp;
+    r.playerName = e.player;
+    r.difficulty = e.difficulty;
+    r.attempts = e.attempts;
+    r.elapsedSeconds = e.seconds;
+    r.secretNumber = e.secret;
+    r.score = e.score;
+    return r;
+}
+
+#ifdef __linux__
+class SharedLeaderboard {
+public:
+    // Attached region for this directory, or null if shared memory is
+    // unavailable (callers fall back to the CSV file)
+    static SharedLeaderboard *instance() {
+        static unique_ptr<SharedLeaderboard> board(attach());
+        return board.get();
+    }
+
+    // Add a batch just appended to the file. If someone else changed the
+    // file since the region was last brought up to date, rebuild instead.
+    void publish(const vector<Result> &batch, const CsvStamp &before) {
+        CsvStamp after = leaderboard_stamp();
+        lock();
+        if (region_->csv == before && after.device == before.device && after.inode == before.inode) {
+            for (auto &r : batch) region_->data.add(board_entry(r));
+            region_->csv = after;
+        } else {
+            reseed_locked();
+        }
+        unlock();
+    }
+
+    // Rebuild from the file if it changed behind the region's back
+    void sync() {
+        if (stamp() == leaderboard_stamp()) return;
+        lock();
+        if (region_->csv != leaderboard_stamp()) reseed_locked();
+        unlock();
+    }
+
+    // Consistent copy of the board; retries while a writer is active
+    void read(BoardData &out) const {
+        while (true) {
+            uint64_t before = region_->seq.load(memory_order_acquire);
+            if (before & 1) { this_thread::yield(); continue; }
+            memcpy(&out, &region_->data, sizeof out);
+            atomic_thread_fence(memory_order_acquire);
+            if (region_->seq.load(memory_order_relaxed) == before) return;
+        }
+    }
+
+private:
+    static constexpr uint32_t LAYOUT_VERSION = 2;
+
+    // All zero when first created, which is an unlocked, empty board for a
+    // missing file. That is exactly right until the file appears.
+    struct Region {
+        atomic<uint32_t> version; // set by the first writer
+        atomic<int32_t> writer;   // pid holding the spinlock, 0 if free
+        atomic<uint64_t> seq;     // odd while an update is in progress
+        CsvStamp csv;             // file the data below reflects
+        BoardData data;
+    };
+    static_assert(atomic<uint64_t>::is_always_lock_free, "seqlock needs lock-free 64-bit atomics");
+
+    explicit SharedLeaderboard(Region *region) : region_(region) {}
+
+    static string region_name() {
+        char cwd[4096];
+        string dir = getcwd(cwd, sizeof cwd) ? cwd : ".";
+        uint64_t h = 1469598103934665603ull;
+        for (unsigned char ch : dir) { h ^= ch; h *= 1099511628211ull; }
+        stringstream ss;
+        ss << "/numberGuessing_lb_" << hex << h;
+        return ss.str();
+    }
+
+    static SharedLeaderboard *attach() {
+        int fd = shm_open(region_name().c_str(), O_RDWR | O_CREAT, 0600);
+        if (fd < 0) return nullptr;
+        // Whoever gets here first sizes the object. Sizing it again to the
+        // same length keeps the contents, so a process that finds it still
+        // empty (its creator has not got that far, or died) can do it too,
+        // and nobody maps it before it is big enough.
+        struct stat st;
+        bool sized = fstat(fd, &st) == 0 &&
+                     (static_cast<size_t>(st.st_size) == sizeof(Region) ||
+                      (st.st_size == 0 && ftruncate(fd, sizeof(Region)) == 0));
+        void *mem = sized ? mmap(nullptr, sizeof(Region), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0) : MAP_FAILED;
+        ::close(fd);
+        if (mem == MAP_FAILED) return nullptr; // unusable, or another build's layout
+        Region *region = static_cast<Region *>(mem);
+
+        uint32_t version = 0;
+        if (!region->version.compare_exchange_strong(version, LAYOUT_VERSION) && version != LAYOUT_VERSION) {
+            munmap(mem, sizeof(Region));
+            return nullptr;
+        }
+        auto board = new SharedLeaderboard(region);
+        board->sync();
+        return board;
+    }
+
+    // Racy copy, only used to skip taking the lock in sync()
+    CsvStamp stamp() const {
+        uint64_t before = region_->seq.load(memory_order_acquire);
+        CsvStamp s = region_->csv;
+        atomic_thread_fence(memory_order_acquire);
+        return region_->seq.load(memory_order_relaxed) == before && !(before & 1) ? s : CsvStamp{~0ull, 0, 0};
+    }
+
+    void reseed_locked() {
+        region_->csv = leaderboard_stamp();
+        memset(&region_->data, 0, sizeof region_->data);
+        for (auto &r : read_leaderboard(numeric_limits<int>::max())) region_->data.add(board_entry(r));
+    }
+
+    void lock() {
+        int32_t self = static_cast<int32_t>(getpid());
+        for (unsigned spins = 1;; ++spins) {
+            int32_t owner = 0;
+            if (region_->writer.compare_exchange_weak(owner, self, memory_order_acquire)) break;
+            // the owner died holding the lock: take it over, and rebuild
+            // afterwards since its update may be half done
+            if (spins % 1024 == 0 && owner != 0 && kill(owner, 0) != 0 && errno == ESRCH &&
+                region_->writer.compare_exchange_strong(owner, self, memory_order_acquire)) {
+                if (region_->seq.load(memory_order_relaxed) & 1) region_->seq.fetch_add(1, memory_order_relaxed);
+                region_->csv = CsvStamp{~0ull, 0, 0};
+                break;
+            }
+            this_thread::yield();
+        }
+        region_->seq.fetch_add(1, memory_order_relaxed);
+        atomic_thread_fence(memory_order_release);
+    }
+
+    void unlock() {
+        region_->seq.fetch_add(1, memory_order_release);
+        region_->writer.store(0, memory_order_release);
+    }
+
+    Region *region_;
+};
+
+void publish_to_shared_leaderboard(const vector<Result> &batch, const CsvStamp &before) {
+    if (auto board = SharedLeaderboard::instance()) board->publish(batch, before);
+}
+#else
+void publish_to_shared_leaderboard(const vector<Result> &, const CsvStamp &) {}
+#endif
+
+// Recent games table, oldest first
+void render_leaderboard(ConsoleWriter &out, const vector<Result> &entries) {
+    TextTable table({{"Time", 20}, {"Player", 15}, {"Diff", 12}, {"Att", 10}, {"Sec", 10}, {"Score", 10}});
+    table.reserve(entries.size());
+    for (auto &e : entries) {
+        table.cell(e.timestamp).cell(e.playerName).cell(e.difficulty).cell(int64_t{e.attempts})
+             .cell(e.elapsedSeconds, 1).cell(e.score, 2);
+    }
+    out << "\nTop " << entries.size() << " recent games:\n";
+    table.render(out, 80);
+    out << '\n';
+}
+
+void show_leaderboard(int n = 10) {
+    ConsoleWriter out;
+    vector<Result> entries;
+#ifdef __linux__
+    if (auto board = SharedLeaderboard::instance()) {
+        board->sync();
+        unique_ptr<BoardData> data(new BoardData());
+        board->read(*data);
+        auto recent = data->recent_games();
+        size_t from = recent.size() > static_cast<size_t>(n) ? recent.size() - n : 0;
+        for (size_t i = from; i < recent.size(); ++i) entries.push_back(result_from_entry(recent[i]));
+        if (data->topCount > 0) {
+            out << "\nBest score per difficulty:\n";
+            for (uint32_t i = 0; i < data->topCount; ++i) {
+                const BoardEntry &best = data->tops[i].entries[0];
+                out << "  ";
+                out.pad(data->tops[i].difficulty, 24).pad(best.player, 15).fixed(best.score, 2) << '\n';
+            }
+        }
+    } else
+#endif
+    entries = read_leaderboard(n);
+    if (entries.empty()) { out << "No leaderboard entries yet.\n"; return; }
+    render_leaderboard(out, entries);
+}
+
+// --bench-console: render an N-row leaderboard through per-field setw
+// insertions (the old show_leaderboard) and through TextTable
+void run_console_benchmark(int rows) {
+    vector<Result> entries(rows);
+    for (int i = 0; i < rows; ++i) {
+        Result &e = entries[i];
+        e.timestamp = "2025-01-10 18:21:33";
+        e.playerName = "Player" + to_string(i % 977);
+        e.difficulty = i % 3 ? "Medium (1-100)" : "Hard (1-1000)";
+        e.attempts = i % 12 + 1;
+        e.elapsedSeconds = (i % 5000) / 7.0;
+        e.score = (i % 9000) / 3.0;
+    }
+    const int reps = 50;
+    ostringstream streamOut;
+    auto start = Clock::now();
+    for (int r = 0; r < reps; ++r) {
+        streamOut.str("");
+        streamOut << "\nTop " << entries.size() << " recent games:\n";
+        streamOut << left << setw(20) << "Time" << setw(15) << "Player" << setw(12) << "Diff" << setw(10) << "Att" << setw(10) << "Sec" << setw(10) << "Score" << '\n';
+        streamOut << string(80, '-') << '\n';
+        for (auto &e : entries) {
+            streamOut << setw(20) << e.timestamp << setw(15) << e.playerName << setw(12) << e.difficulty << setw(10) << e.attempts << setw(10) << fixed << setprecision(1) << e.elapsedSeconds << setw(10) << fixed << setprecision(2) << e.score << '\n';
+        }
+    }
+    double streamUs = chrono::duration<double, micro>(Clock::now() - start).count() / reps;
+    size_t bytes = 0;
+    start = Clock::now();
+    for (int r = 0; r < reps; ++r) {
+        ConsoleWriter out;
+        render_leaderboard(out, entries);
+        bytes = out.str().size();
+        out.clear(); // measure layout only, not the terminal
+    }
+    double tableUs = chrono::duration<double, micro>(Clock::now() - start).count() / reps;
+    ConsoleWriter out;
+    out << "Rendering a " << rows << "-row leaderboard (" << bytes << " bytes):\n";
+    out << "  setw/setprecision on a stream: ";
+    out.fixed(streamUs, 1) << " us\n";
+    out << "  TextTable + ConsoleWriter:     ";
+    out.fixed(tableUs, 1) << " us\n";
+}
+
+#ifdef __linux__
+// ---------- Live leaderboard (--watch) ----------
+// A wall display that tails leaderboard.csv. An inotify watch on the
+// directory wakes the loop only when the file is written, created, renamed
+// or removed, so an idle display sits in read() and uses no CPU. Appended
+// bytes are read from the last offset and each complete line is parsed once
+// into a BoardData: the same incremental top-N and recent ring that the
+// shared-memory board uses. Each frame is compared with the one on screen,
+// and only the lines that changed are rewritten, using ANSI cursor moves,
+// in one write.
+class LeaderboardTail {
+public:
+    explicit LeaderboardTail(string path) : path_(move(path)), board_(new BoardData()) { reset(); }
+    ~LeaderboardTail() {
+        if (fd_ >= 0) ::close(fd_);
+    }
+    LeaderboardTail(const LeaderboardTail &) = delete;
+    LeaderboardTail &operator=(const LeaderboardTail &) = delete;
+
+    // Forget everything and read the file again from the start (it was
+    // created, replaced, removed or truncated)
+    void reset() {
+        if (fd_ >= 0) ::close(fd_);
+        fd_ = ::open(path_.c_str(), O_RDONLY | O_CLOEXEC);
+        offset_ = 0;
+        pending_.clear();
+        *board_ = BoardData();
+        games_ = 0;
+    }
+
+    // Parse whatever was appended since the last call; true if the board
+    // changed (rows added, or the file was truncated and read again)
+    bool catch_up() {
+        if (fd_ < 0) {
+            reset();
+            if (fd_ < 0) return false;
+        }
+        bool added = false;
+        struct stat st;
+        if (fstat(fd_, &st) == 0 && st.st_size < offset_) {
+            reset();
+            added = true;
+        }
+        char buf[64 * 1024];
+        ssize_t n;
+        while ((n = ::pread(fd_, buf, sizeof buf, offset_)) > 0) {
+            offset_ += n;
+            const char *begin = buf, *end = buf + n;
+            for (const char *nl; (nl = static_cast<const char *>(memchr(begin, '\n', end - begin))); begin = nl + 1) {
+                pending_.append(begin, nl);
+                Result r;
+                if (parse_leaderboard_row(pending_, r)) {
+                    board_->add(board_entry(r));
+                    ++games_;
+                    added = true;
+                }
+                pending_.clear();
+            }
+            pending_.append(begin, end); // a row still being written
+        }
+        return added;
+    }
+
+    const BoardData &board() const { return *board_; }
+    uint64_t games() const { return games_; }
+
+private:
+    string path_;
+    int fd_ = -1;
+    off_t offset_ = 0;
+    string pending_;
+    unique_ptr<BoardData> board_; // ~14 KB, kept off the stack
+    uint64_t games_ = 0;
+};
+
+// The watch screen, one string per terminal line
+vector<string> watch_frame(const LeaderboardTail &tail) {
+    constexpr uint32_t TOP_SHOWN = 3, RECENT_SHOWN = 10;
+    const BoardData &board = tail.board();
+    ConsoleWriter text;
+    text << "Leaderboard (" << LEADERBOARD_FILE << "), games recorded: " << tail.games() << "   (Ctrl+C to quit)\n\n";
+    if (tail.games() == 0) text << "No leaderboard entries yet.\n";
+    if (board.topCount > 0) {
+        TextTable best({{"Difficulty", 24}, {"#", 4}, {"Player", 15}, {"Score", 10}});
+        for (uint32_t i = 0; i < board.topCount; ++i) {
+            const BoardData::Top &top = board.tops[i];
+            for (uint32_t k = 0; k < min(top.count, TOP_SHOWN); ++k)
+                best.cell(k == 0 ? string_view(top.difficulty) : string_view()).cell(int64_t{k + 1})
+                    .cell(top.entries[k].player).cell(top.entries[k].score, 2);
+        }
+        text << "Best scores:\n";
+        best.render(text, 0);
+    }
+    if (board.recentCount > 0) {
+        TextTable recent({{"Time", 20}, {"Player", 15}, {"Diff", 12}, {"Att", 6}, {"Sec", 8}, {"Score", 10}});
+        uint32_t shown = min(board.recentCount, RECENT_SHOWN);
+        for (uint32_t i = 1; i <= shown; ++i) { // newest first
+            const BoardEntry &e = board.recent[(board.recentHead + BoardData::RECENT_N - i) % BoardData::RECENT_N];
+            recent.cell(e.timestamp).cell(e.player).cell(e.difficulty).cell(int64_t{e.attempts})
+                .cell(e.seconds, 1).cell(e.score, 2);
+        }
+        text << "\nRecent games:\n";
+        recent.render(text, 0);
+    }
+
+    vector<string> lines;
+    const string &s = text.str();
+    for (size_t begin = 0, nl; (nl = s.find('\n', begin)) != string::npos; begin = nl + 1)
+        lines.emplace_back(s, begin, nl - begin);
+    text.clear(); // the lines are drawn by TerminalFrame, not printed as-is
+    return lines;
+}
+
+// What is on the terminal now, so the next frame rewrites only what differs
+class TerminalFrame {
+public:
+    TerminalFrame() {
+        ConsoleWriter out;
+        out << "\x1b[?25l\x1b[H\x1b[2J"; // hide the cursor, clear the screen
+    }
+    ~TerminalFrame() {
+        ConsoleWriter out;
+        out << "\x1b[" << shown_.size() + 1 << ";1H\x1b[?25h"; // below the frame, cursor back on
+    }
+    TerminalFrame(const TerminalFrame &) = delete;
+    TerminalFrame &operator=(const TerminalFrame &) = delete;
+
+    // Returns the number of lines rewritten
+    size_t draw(vector<string> lines) {
+        ConsoleWriter out;
+        size_t changed = 0;
+        for (size_t i = 0; i < lines.size(); ++i) {
+            if (i < shown_.size() && shown_[i] == lines[i]) continue;
+            out << "\x1b[" << i + 1 << ";1H" << lines[i] << "\x1b[K";
+            ++changed;
+        }
+        if (lines.size() < shown_.size()) out << "\x1b[" << lines.size() + 1 << ";1H\x1b[J";
+        shown_ = move(lines);
+        return changed;
+    }
+
+private:
+    vector<string> shown_;
+};
+
+volatile sig_atomic_t watchStop = 0;
+
+int run_watch() {
+    int events = inotify_init1(IN_CLOEXEC);
+    if (events < 0 || inotify_add_watch(events, ".", IN_MODIFY | IN_CREATE | IN_MOVED_TO | IN_MOVED_FROM | IN_DELETE) < 0) {
+        cerr << "Could not watch the leaderboard: " << strerror(errno) << "\n";
+        if (events >= 0) ::close(events);
+        return 1;
+    }
+    // no SA_RESTART: Ctrl+C interrupts the blocking read below
+    struct sigaction sa {};
+    sa.sa_handler = [](int) { watchStop = 1; };
+    sigaction(SIGINT, &sa, nullptr);
+    sigaction(SIGTERM, &sa, nullptr);
+
+    LeaderboardTail tail(LEADERBOARD_FILE);
+    tail.catch_up();
+    {
+        TerminalFrame frame;
+        frame.draw(watch_frame(tail));
+        alignas(inotify_event) char buf[4096];
+        while (!watchStop) {
+            ssize_t n = ::read(events, buf, sizeof buf);
+            if (n <= 0) {
+                if (n < 0 && errno == EINTR) continue;
+                break;
+            }
+            // one read returns every queued event, so a burst of games is one redraw
+            bool replaced = false;
+            for (char *p = buf; p < buf + n;) {
+                auto *ev = reinterpret_cast<inotify_event *>(p);
+                p += sizeof(inotify_event) + ev->len;
+                if (ev->len > 0 && LEADERBOARD_FILE == ev->name && !(ev->mask & IN_MODIFY)) replaced = true;
+            }
+            if (replaced) tail.reset();
+            if (tail.catch_up() || replaced) frame.draw(watch_frame(tail));
+        }
+    }
+    ::close(events);
+    return 0;
+}
+#endif
+
+// ---------- External sort ----------
+// --sort writes leaderboard.csv ordered by any Result field, with memory
+// use bounded by a budget rather than the file size. Phase 1 reads the file
+// and cuts it into runs that fit the budget. Each run is stable-sorted on a
+// worker thread and written to a temporary file while the next one is read.
+// Phase 2 merges up to MERGE_FAN_IN runs at a time through a loser tree:
+// each step costs log2(runs) comparisons, all along one leaf-to-root path.
+// With more runs than that, intermediate passes first merge groups of
+// consecutive runs into longer ones, so open files and read buffers stay
+// bounded however large the input. Ties go to the earlier run and groups
+// keep run order, so the whole sort is stable. Output rows are the input
+// lines, byte for byte. A run that cannot be opened or is cut short stops
+// the sort rather than yielding a partial output.
+//
+// A run file holds (key length, line length, key, line) records. Keys are
+// encoded so that plain byte comparison gives the field's order: integers
+// big-endian with the sign bit flipped, doubles by their IEEE bits, strings
+// as-is. One comparator then serves every field.
+constexpr size_t MERGE_FAN_IN = 64;
+
+enum class SortField { Timestamp, Player, Difficulty, Attempts, Seconds, Secret, Score };
+
+bool parse_sort_field(const string &name, SortField &out) {
+    static const pair<const char *, SortField> FIELDS[] = {
+        {"timestamp", SortField::Timestamp}, {"player", SortField::Player}, {"difficulty", SortField::Difficulty},
+        {"attempts", SortField::Attempts},   {"seconds", SortField::Seconds}, {"secret", SortField::Secret},
+        {"score", SortField::Score}};
+    for (auto &f : FIELDS)
+        if (name == f.first) { out = f.second; return true; }
+    return false;
+}
+
+void append_sort_key(string &key, uint64_t bits) {
+    for (int shift = 56; shift >= 0; shift -= 8) key += static_cast<char>(bits >> shift);
+}
+
+string sort_key(const Result &r, SortField field) {
+    string key;
+    auto ordered_int = [&](int64_t v) { append_sort_key(key, static_cast<uint64_t>(v) ^ (1ull << 63)); };
+    auto ordered_double = [&](double v) {
+        uint64_t bits;
+        memcpy(&bits, &v, sizeof bits);
+        append_sort_key(key, bits >> 63 ? ~bits : bits | (1ull << 63));
+    };
+    switch (field) {
+    case SortField::Timestamp: key = r.timestamp; break;
+    case SortField::Player: key = r.playerName; break;
+    case SortField::Difficulty: key = r.difficulty; break;
+    case SortField::Attempts: ordered_int(r.attempts); break;
+    case SortField::Seconds: ordered_double(r.elapsedSeconds); break;
+    case SortField::Secret: ordered_int(r.secretNumber); break;
+    case SortField::Score: ordered_double(r.score); break;
+    }
+    return key;
+}
+
+struct SortRecord {
+    string key;
+    string line;
+};
+
+void write_sort_record(ostream &os, const SortRecord &rec) {
+    uint32_t sizes[2] = {static_cast<uint32_t>(rec.key.size()), static_cast<uint32_t>(rec.line.size())};
+    os.write(reinterpret_cast<const char *>(sizes), sizeof sizes);
+    os.write(rec.key.data(), static_cast<streamsize>(rec.key.size()));
+    os.write(rec.line.data(), static_cast<streamsize>(rec.line.size()));
+}
+
+// Sequential reader over one run file, holding its current record.
+// failed() tells an unopenable or cut-short file from one read to its end.
+class RunReader {
+public:
+    RunReader(const string &path, size_t bufferSize) : buffer_(bufferSize) {
+        in_.rdbuf()->pubsetbuf(buffer_.data(), static_cast<streamsize>(buffer_.size()));
+        in_.open(path, ios::binary);
+        if (!in_.is_open()) { done_ = failed_ = true; return; }
+        next();
+    }
+
+    bool done() const { return done_; }
+    bool failed() const { return failed_; }
+    const SortRecord &current() const { return rec_; }
+
+    void next() {
+        uint32_t sizes[2];
+        if (!in_.read(reinterpret_cast<char *>(sizes), sizeof sizes)) {
+            done_ = true;
+            failed_ = in_.gcount() != 0 || in_.bad(); // clean end only on a record boundary
+            return;
+        }
+        rec_.key.resize(sizes[0]);
+        rec_.line.resize(sizes[1]);
+        in_.read(&rec_.key[0], sizes[0]);
+        in_.read(&rec_.line[0], sizes[1]);
+        if (!in_) done_ = failed_ = true;
+    }
+
+private:
+    vector<char> buffer_;
+    ifstream in_;
+    SortRecord rec_;
+    bool done_ = false;
+    bool failed_ = false;
+};
+
+// Tournament tree of losers over k sources. tree_[0] holds the current
+// winner and tree_[1..k-1] the loser of each internal match. Replacing the
+// winner's record replays only the matches on its path to the root.
+// beats(a, b) must be a strict order that puts exhausted sources last.
+template <typename Beats>
+class LoserTree {
+public:
+    LoserTree(size_t k, Beats beats) : k_(k), beats_(beats), tree_(k, k) {
+        // index k is a sentinel that wins every match; each real leaf pushes
+        // one out, so after the loop the tree holds only real sources
+        for (size_t i = k; i-- > 0;) replay(i);
+    }
+
+    size_t winner() const { return tree_[0]; }
+
+    // The winner's source moved on to its next record
+    void replay(size_t leaf) {
+        for (size_t node = (leaf + k_) / 2; node > 0; node /= 2)
+            if (wins(tree_[node], leaf)) swap(leaf, tree_[node]);
+        tree_[0] = leaf;
+    }
+
+private:
+    bool wins(size_t a, size_t b) const {
+        if (a == k_) return true;
+        if (b == k_) return false;
+        return beats_(a, b);
+    }
+
+    size_t k_;
+    Beats beats_;
+    vector<size_t> tree_;
+};
+
+// Merge `inputs`, given in run order, into `outputPath`: as run records for
+// an intermediate pass, as plain lines for the last one. Returns an error
+// message, empty on success.
+template <typename Before>
+string merge_runs(const vector<string> &inputs, const string &outputPath, bool finalPass, size_t readBuffer,
+                  Before before) {
+    vector<unique_ptr<RunReader>> readers;
+    for (auto &path : inputs) {
+        readers.emplace_back(new RunReader(path, readBuffer));
+        if (readers.back()->failed()) return "Could not read temporary run " + path;
+    }
+    auto beats = [&](size_t a, size_t b) {
+        if (readers[a]->done()) return false;
+        if (readers[b]->done()) return true;
+        const string &ka = readers[a]->current().key, &kb = readers[b]->current().key;
+        if (before(ka, kb)) return true;
+        if (before(kb, ka)) return false;
+        return a < b; // earlier run first keeps the sort stable
+    };
+    vector<char> outBuffer(1 << 20);
+    ofstream out;
+    out.rdbuf()->pubsetbuf(outBuffer.data(), static_cast<streamsize>(outBuffer.size()));
+    out.open(outputPath, ios::binary | ios::trunc);
+    if (!out) return "Could not create " + outputPath;
+    if (!readers.empty()) {
+        LoserTree<decltype(beats)> tree(readers.size(), beats);
+        for (size_t w = tree.winner(); !readers[w]->done(); w = tree.winner()) {
+            const SortRecord &rec = readers[w]->current();
+            if (finalPass) {
+                out.write(rec.line.data(), static_cast<streamsize>(rec.line.size()));
+                out.put('\n');
+            } else {
+                write_sort_record(out, rec);
+            }
+            readers[w]->next();
+            if (readers[w]->failed()) {
+                out.close();
+                remove(outputPath.c_str()); // no partial output
+                return "Temporary run " + inputs[w] + " is truncated or unreadable";
+            }
+            tree.replay(w);
+        }
+    }
+    out.close();
+    if (!out) return "Could not write " + outputPath;
+    return {};
+}
+
+int run_external_sort(SortField field, bool descending, size_t memoryBudget, const string &outputPath) {
+    ifstream in(LEADERBOARD_FILE, ios::binary);
+    if (!in) {
+        cerr << "Could not read " << LEADERBOARD_FILE << "\n";
+        return 1;
+    }
+    auto before = [descending](const string &a, const string &b) { return descending ? b < a : a < b; };
+    const size_t threads = max(1u, min(8u, thread::hardware_concurrency()));
+    // the run being filled plus one per sorting thread share the budget
+    const size_t runBudget = max<size_t>(1 << 20, memoryBudget / (threads + 1));
+    auto start = Clock::now();
+
+    // Phase 1: sorted runs
+    vector<string> runs;
+    deque<thread> sorting;
+    mutex failMutex;
+    string error;
+    auto spill = [&](vector<SortRecord> batch) {
+        if (sorting.size() == threads) {
+            sorting.front().join();
+            sorting.pop_front();
+        }
+        string path = outputPath + ".run." + to_string(runs.size());
+        runs.push_back(path);
+        sorting.emplace_back([&, path, batch = move(batch)]() mutable {
+            stable_sort(batch.begin(), batch.end(), [&](const SortRecord &a, const SortRecord &b) { return before(a.key, b.key); });
+            ofstream out(path, ios::binary | ios::trunc);
+            for (auto &rec : batch) write_sort_record(out, rec);
+            out.close();
+            if (!out) {
+                lock_guard<mutex> lock(failMutex);
+                if (error.empty()) error = "Could not write temporary run " + path;
+            }
+        });
+    };
+    vector<SortRecord> batch;
+    size_t batchBytes = 0, rows = 0, skipped = 0;
+    uint64_t inputBytes = 0;
+    string line;
+    while (getline(in, line)) {
+        inputBytes += line.size() + 1;
+        Result r;
+        if (!parse_leaderboard_row(line, r)) {
+            if (!line.empty()) ++skipped;
+            continue;
+        }
+        SortRecord rec{sort_key(r, field), move(line)};
+        batchBytes += rec.key.capacity() + rec.line.capacity() + sizeof rec;
+        batch.push_back(move(rec));
+        ++rows;
+        if (batchBytes >= runBudget) {
+            spill(move(batch));
+            batch = {};
+            batchBytes = 0;
+        }
+    }
+    if (!batch.empty()) spill(move(batch));
+    for (auto &t : sorting) t.join();
+    double splitSecs = chrono::duration<double>(Clock::now() - start).count();
+
+    // Phase 2: k-way merge, in as many passes as the fan-in needs
+    size_t runCount = runs.size(), passes = 0, nextRun = runs.size();
+    size_t fanIn = min(MERGE_FAN_IN, max<size_t>(1, runs.size()));
+    size_t readBuffer = max<size_t>(4096, min<size_t>(1 << 20, memoryBudget / 2 / fanIn));
+    vector<string> temporaries = runs;
+    while (error.empty() && runs.size() > MERGE_FAN_IN) {
+        vector<string> merged;
+        for (size_t i = 0; i < runs.size() && error.empty(); i += MERGE_FAN_IN) {
+            vector<string> group(runs.begin() + i, runs.begin() + min(runs.size(), i + MERGE_FAN_IN));
+            if (group.size() == 1) { merged.push_back(group[0]); continue; }
+            string path = outputPath + ".run." + to_string(nextRun++);
+            temporaries.push_back(path);
+            merged.push_back(path);
+            error = merge_runs(group, path, false, readBuffer, before);
+            for (auto &done : group) remove(done.c_str()); // free the disk as we go
+        }
+        runs = move(merged);
+        ++passes;
+    }
+    if (error.empty()) error = merge_runs(runs, outputPath, true, readBuffer, before);
+    for (auto &path : temporaries) remove(path.c_str());
+    double totalSecs = chrono::duration<double>(Clock::now() - start).count();
+
+    if (!error.empty()) {
+        cerr << error << "\n";
+        return 1;
+    }
+    ConsoleWriter report;
+    double mb = inputBytes / 1e6;
+    report << "Sorted " << rows << " rows (" << runCount << " runs, " << passes + 1 << " merge passes, " << threads
+           << " threads) into " << outputPath << "\n";
+    if (skipped) report << "Skipped " << skipped << " malformed rows\n";
+    report << "  split and sort: ";
+    report.fixed(splitSecs, 2) << " s\n  merge:          ";
+    report.fixed(totalSecs - splitSecs, 2) << " s\n  ";
+    report.fixed(mb, 1) << " MB at ";
+    report.fixed(totalSecs > 0 ? mb / totalSecs : 0, 1) << " MB/s\n";
+    return 0;
+}
+
+// ---------- Group-by reports ----------
+// --group-by runs aggregate reports (per player, difficulty or day) over
+// leaderboard.csv. The file is cut into one newline-aligned chunk per
+// thread. Each thread fills its own GroupTable with no shared state, and
+// the partial tables are then merged into one.
+//
+// A GroupTable is an open-addressing hash table. Each group key is
+// interned once into a byte arena, and slots hold the hash, the key's place
+// in the arena and the group number. Group statistics live in flat arrays
+// indexed by group number. Quantiles are approximate: a log-bucketed sketch
+// per group and field (relative error under 1%) that merges by adding
+// bucket counts.
+enum class GroupKey { Player, Difficulty, Day, All };
+enum class AggField { Attempts, Seconds, Secret, Score };
+enum class AggOp { Count, Sum, Min, Max, Mean, Quantile };
+
+struct AggSpec {
+    AggOp op;
+    AggField field;
+    double q;     // Quantile only, in [0, 1]
+    string label; // column header, e.g. "p90(seconds)"
+};
+
+double agg_value(const Result &r, AggField f) {
+    switch (f) {
+    case AggField::Attempts: return r.attempts;
+    case AggField::Seconds: return r.elapsedSeconds;
+    case AggField::Secret: return static_cast<double>(r.secretNumber);
+    case AggField::Score: return r.score;
+    }
+    return 0;
+}
+
+// Comma-separated list of count, sum:F, min:F, max:F, mean:F and pNN:F,
+// where F is attempts, seconds, secret or score and NN a percentile
+bool parse_agg_specs(const string &list, vector<AggSpec> &out, string &error) {
+    static const pair<const char *, AggField> FIELDS[] = {
+        {"attempts", AggField::Attempts}, {"seconds", AggField::Seconds}, {"secret", AggField::Secret}, {"score", AggField::Score}};
+    static const pair<const char *, AggOp> OPS[] = {
+        {"sum", AggOp::Sum}, {"min", AggOp::Min}, {"max", AggOp::Max}, {"mean", AggOp::Mean}};
+    stringstream ss(list);
+    string item;
+    while (getline(ss, item, ',')) {
+        if (item == "count") { out.push_back({AggOp::Count, AggField::Score, 0, "count"}); continue; }
+        size_t colon = item.find(':');
+        string op = item.substr(0, colon), field = colon == string::npos ? "" : item.substr(colon + 1);
+        AggSpec spec{AggOp::Count, AggField::Score, 0, op + "(" + field + ")"};
+        auto f = find_if(begin(FIELDS), end(FIELDS), [&](auto &p) { return field == p.first; });
+        if (f == end(FIELDS)) { error = "unknown field in '" + item + "'"; return false; }
+        spec.field = f->second;
+        auto o = find_if(begin(OPS), end(OPS), [&](auto &p) { return op == p.first; });
+        if (o != end(OPS)) {
+            spec.op = o->second;
+        } else if (op.size() > 1 && op[0] == 'p' && op.find_first_not_of("0123456789.", 1) == string::npos) {
+            spec.op = AggOp::Quantile;
+            spec.q = atof(op.c_str() + 1) / 100.0;
+            if (spec.q < 0 || spec.q > 1) { error = "percentile out of range in '" + item + "'"; return false; }
+        } else {
+            error = "unknown aggregate in '" + item + "'";
+            return false;
+        }
+        out.push_back(spec);
+    }
+    if (out.empty()) error = "no aggregates given";
+    return !out.empty();
+}
+
+// DDSketch-style quantile sketch: bucket i holds values in
+// (gamma^(i-1), gamma^i], so any value it reports is within ALPHA of a true
+// value of that rank. Negative values get a mirrored store; zero its own count.
+class QuantileSketch {
+public:
+    static constexpr double ALPHA = 0.01;
+
+    void add(double v) {
+        ++count_;
+        if (v > MIN_MAGNITUDE) positive_.add(bucket(v));
+        else if (v < -MIN_MAGNITUDE) negative_.add(bucket(-v));
+        else ++zeros_;
+    }
+
+    void merge(const QuantileSketch &o) {
+        count_ += o.count_;
+        zeros_ += o.zeros_;
+        positive_.merge(o.positive_);
+        negative_.merge(o.negative_);
+    }
+
+    double quantile(double q) const {
+        if (count_ == 0) return 0;
+        uint64_t rank = static_cast<uint64_t>(q * static_cast<double>(count_ - 1)); // 0-based
+        for (size_t i = negative_.counts.size(); i-- > 0;) { // most negative first
+            if (rank < negative_.counts[i]) return -value(negative_.offset + static_cast<int>(i));
+            rank -= negative_.counts[i];
+        }
+        if (rank < zeros_) return 0;
+        rank -= zeros_;
+        for (size_t i = 0; i < positive_.counts.size(); ++i) {
+            if (rank < positive_.counts[i]) return value(positive_.offset + static_cast<int>(i));
+            rank -= positive_.counts[i];
+        }
+        return 0;
+    }
+
+private:
+    static constexpr double MIN_MAGNITUDE = 1e-9;
+
+    // Dense counts for bucket indices offset, offset + 1, ...; grows either way
+    struct Store {
+        int offset = 0;
+        vector<uint64_t> counts;
+
+        void add(int index, uint64_t n = 1) {
+            if (counts.empty()) offset = index;
+            if (index < offset) {
+                counts.insert(counts.begin(), static_cast<size_t>(offset - index), 0);
+                offset = index;
+            }
+            size_t i = static_cast<size_t>(index - offset);
+            if (i >= counts.size()) counts.resize(i + 1, 0);
+            counts[i] += n;
+        }
+
+        void merge(const Store &o) {
+            for (size_t i = 0; i < o.counts.size(); ++i)
+                if (o.counts[i]) add(o.offset + static_cast<int>(i), o.counts[i]);
+        }
+    };
+
+    static double log_gamma() {
+        static const double lg = log((1 + ALPHA) / (1 - ALPHA));
+        return lg;
+    }
+    static int bucket(double magnitude) { return static_cast<int>(ceil(log(magnitude) / log_gamma())); }
+    static double value(int index) { return 2 * exp(index * log_gamma()) / (exp(log_gamma()) + 1); }
+
+    uint64_t count_ = 0, zeros_ = 0;
+    Store positive_, negative_;
+};
+
+class GroupTable {
+public:
+    explicit GroupTable(const vector<AggSpec> &specs) {
+        for (auto &s : specs) {
+            if (s.op == AggOp::Count) continue;
+            auto slot = [](vector<AggField> &v, AggField f) {
+                auto it = find(v.begin(), v.end(), f);
+                if (it == v.end()) { v.push_back(f); return v.size() - 1; }
+                return static_cast<size_t>(it - v.begin());
+            };
+            slot(fields_, s.field);
+            if (s.op == AggOp::Quantile) slot(sketchFields_, s.field);
+        }
+        slots_.assign(64, Slot{});
+    }
+
+    size_t groups() const { return counts_.size(); }
+    string_view key(uint32_t group) const { return string_view(arena_.data() + keys_[group].first, keys_[group].second); }
+
+    // Group number for `key`, adding the group if it is new
+    uint32_t intern(string_view key) { return intern(key, hash_key(key)); }
+
+    void add(uint32_t group, const Result &r) {
+        ++counts_[group];
+        Stats *st = &stats_[group * fields_.size()];
+        for (size_t f = 0; f < fields_.size(); ++f) {
+            double v = agg_value(r, fields_[f]);
+            st[f].add_to_sum(v);
+            st[f].min = min(st[f].min, v);
+            st[f].max = max(st[f].max, v);
+        }
+        QuantileSketch *sk = sketchFields_.empty() ? nullptr : &sketches_[group * sketchFields_.size()];
+        for (size_t f = 0; f < sketchFields_.size(); ++f) sk[f].add(agg_value(r, sketchFields_[f]));
+    }
+
+    // Fold in a partial table built from the same specs
+    void merge(const GroupTable &o) {
+        for (uint32_t g = 0; g < o.groups(); ++g) {
+            uint32_t mine = intern(o.key(g), o.hashes_[g]);
+            counts_[mine] += o.counts_[g];
+            for (size_t f = 0; f < fields_.size(); ++f) {
+                Stats &a = stats_[mine * fields_.size() + f];
+                const Stats &b = o.stats_[g * fields_.size() + f];
+                a.add_to_sum(b.sum);
+                a.add_to_sum(b.carry);
+                a.min = min(a.min, b.min);
+                a.max = max(a.max, b.max);
+            }
+            for (size_t f = 0; f < sketchFields_.size(); ++f)
+                sketches_[mine * sketchFields_.size() + f].merge(o.sketches_[g * sketchFields_.size() + f]);
+        }
+    }
+
+    double result(uint32_t group, const AggSpec &spec) const {
+        uint64_t n = counts_[group];
+        if (spec.op == AggOp::Count) return static_cast<double>(n);
+        const Stats &st = stats_[group * fields_.size() + field_index(fields_, spec.field)];
+        switch (spec.op) {
+        case AggOp::Sum: return st.total();
+        case AggOp::Min: return st.min;
+        case AggOp::Max: return st.max;
+        case AggOp::Mean: return st.total() / static_cast<double>(n);
+        default: break;
+        }
+        const QuantileSketch &sk = sketches_[group * sketchFields_.size() + field_index(sketchFields_, spec.field)];
+        return min(st.max, max(st.min, sk.quantile(spec.q))); // exact extremes are known
+    }
+
+private:
+    static constexpr uint32_t EMPTY = numeric_limits<uint32_t>::max();
+
+    struct Slot {
+        uint64_t hash = 0;
+        uint32_t group = EMPTY;
+    };
+
+    struct Stats {
+        double sum = 0;
+        double carry = 0; // Neumaier compensation, so the chunking cannot change the result
+        double min = numeric_limits<double>::infinity();
+        double max = -numeric_limits<double>::infinity();
+
+        void add_to_sum(double v) {
+            double t = sum + v;
+            carry += fabs(sum) >= fabs(v) ? (sum - t) + v : (v - t) + sum;
+            sum = t;
+        }
+        double total() const { return sum + carry; }
+    };
+
+    // FNV-1a with a final mix, so the low bits used for probing are spread
+    static uint64_t hash_key(string_view key) {
+        uint64_t h = 1469598103934665603ull;
+        for (unsigned char ch : key) {
+            h ^= ch;
+            h *= 1099511628211ull;
+        }
+        return h ^ (h >> 31);
+    }
+
+    static size_t field_index(const vector<AggField> &v, AggField f) {
+        return static_cast<size_t>(find(v.begin(), v.end(), f) - v.begin());
+    }
+
+    uint32_t intern(string_view key, uint64_t h) {
+        size_t mask = slots_.size() - 1;
+        for (size_t i = h & mask;; i = (i + 1) & mask) {
+            Slot &s = slots_[i];
+            if (s.group == EMPTY) break;
+            if (s.hash == h && this->key(s.group) == key) return s.group;
+        }
+        uint32_t group = static_cast<uint32_t>(counts_.size());
+        keys_.emplace_back(arena_.size(), key.size());
+        arena_.append(key.data(), key.size());
+        hashes_.push_back(h);
+        counts_.push_back(0);
+        stats_.resize(stats_.size() + fields_.size());
+        sketches_.resize(sketches_.size() + sketchFields_.size());
+        if (counts_.size() * 10 > slots_.size() * 7) rehash(); // keep load under 70%
+        place(h, group);
+        return group;
+    }
+
+    void place(uint64_t h, uint32_t group) {
+        size_t mask = slots_.size() - 1, i = h & mask;
+        while (slots_[i].group != EMPTY && slots_[i].group != group) i = (i + 1) & mask;
+        slots_[i] = Slot{h, group};
+    }
+
+    void rehash() {
+        slots_.assign(slots_.size() * 2, Slot{});
+        for (uint32_t g = 0; g < counts_.size(); ++g) place(hashes_[g], g);
+    }
+
+    vector<AggField> fields_, sketchFields_;
+    vector<Slot> slots_;
+    string arena_;                     // interned keys, back to back
+    vector<pair<size_t, size_t>> keys_; // offset and length in arena_
+    vector<uint64_t> hashes_;
+    vector<uint64_t> counts_;
+    vector<Stats> stats_;              // groups x fields_
+    vector<QuantileSketch> sketches_;  // groups x sketchFields_
+};
+
+string_view group_key(const Result &r, GroupKey by) {
+    switch (by) {
+    case GroupKey::Player: return r.playerName;
+    case GroupKey::Difficulty: return r.difficulty;
+    case GroupKey::Day: return string_view(r.timestamp).substr(0, 10); // YYYY-MM-DD
+    case GroupKey::All: return "all";
+    }
+    return {};
+}
+
+// Aggregate the rows whose first byte lies in [from, to) of the file;
+// returns the number of rows added
+uint64_t aggregate_chunk(const string &path, uint64_t from, uint64_t to, GroupKey by, GroupTable &table) {
+    ifstream in(path, ios::binary);
+    vector<char> buffer(1 << 16);
+    in.rdbuf()->pubsetbuf(buffer.data(), static_cast<streamsize>(buffer.size()));
+    uint64_t pos = from;
+    string line;
+    if (from > 0) {
+        // a line that starts before `from` belongs to the previous chunk
+        in.seekg(static_cast<streamoff>(from - 1));
+        char prev = 0;
+        in.get(prev);
+        if (prev != '\n') {
+            getline(in, line);
+            pos += line.size() + 1;
+        }
+    }
+    Result r; // reused, so parsing keeps its string capacity
+    uint64_t rows = 0;
+    while (pos < to && getline(in, line)) {
+        pos += line.size() + 1;
+        if (!parse_leaderboard_row(line, r)) continue;
+        table.add(table.intern(group_key(r, by)), r);
+        ++rows;
+    }
+    return rows;
+}
+
+int run_group_report(GroupKey by, const vector<AggSpec> &specs, int threadCount) {
+    struct stat st;
+    if (stat(LEADERBOARD_FILE.c_str(), &st) != 0) {
+        cerr << "Could not read " << LEADERBOARD_FILE << "\n";
+        return 1;
+    }
+    uint64_t size = static_cast<uint64_t>(st.st_size);
+    size_t threads = static_cast<size_t>(max(1, threadCount));
+    if (size < (1 << 20)) threads = 1; // not worth splitting
+    auto start = Clock::now();
+
+    vector<GroupTable> partials(threads, GroupTable(specs));
+    vector<uint64_t> rows(threads, 0);
+    vector<thread> workers;
+    for (size_t t = 0; t < threads; ++t)
+        workers.emplace_back([&, t] {
+            rows[t] = aggregate_chunk(LEADERBOARD_FILE, size * t / threads, size * (t + 1) / threads, by, partials[t]);
+        });
+    for (auto &w : workers) w.join();
+    double scanSecs = chrono::duration<double>(Clock::now() - start).count();
+
+    GroupTable total(specs);
+    for (auto &p : partials) total.merge(p);
+    uint64_t totalRows = 0;
+    for (auto n : rows) totalRows += n;
+    double secs = chrono::duration<double>(Clock::now() - start).count();
+
+    vector<uint32_t> order(total.groups());
+    for (uint32_t g = 0; g < order.size(); ++g) order[g] = g;
+    sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return total.key(a) < total.key(b); });
+
+    static const char *GROUP_NAMES[] = {"Player", "Difficulty", "Day", "Group"};
+    vector<TextTable::Column> columns{{GROUP_NAMES[static_cast<int>(by)], 16}};
+    for (auto &s : specs) columns.push_back({s.label, 12});
+    TextTable table(move(columns));
+    table.reserve(order.size());
+    for (uint32_t g : order) {
+        table.cell(total.key(g));
+        for (auto &s : specs) {
+            if (s.op == AggOp::Count) table.cell(static_cast<int64_t>(total.result(g, s)));
+            else table.cell(total.result(g, s), 2);
+        }
+    }
+    ConsoleWriter out;
+    table.render(out, 0);
+    out << '\n' << totalRows << " rows, " << total.groups() << " groups, " << threads << " threads: scan ";
+    out.fixed(scanSecs * 1000, 1) << " ms, merge ";
+    out.fixed((secs - scanSecs) * 1000, 1) << " ms, ";
+    out.fixed(secs > 0 ? totalRows / secs / 1e6 : 0, 2) << " M rows/s\n";
+    return 0;
+}
+
+// ---------- Game logic ----------
+// Use fast time-seeded mt19937 to avoid slow random_device on some Windows/MinGW setups
+mt19937_64 &rng() {
+    static uint64_t seed = static_cast<uint64_t>(Clock::now().time_since_epoch().count());
+    static mt19937_64 gen(seed);
+    return gen;
+}
+
+// Create a random integer in [minv, maxv]
+template <typename T>
+T random_int(T minv, T maxv) {
+    uniform_int_distribution<T> dist(minv, maxv);
+    return dist(rng());
+}
+
+// Number of values in the range, computed in the unsigned type so full-width
+// ranges cannot overflow
+template <typename T>
+double range_size(const BasicGameConfig<T> &cfg) {
+    using U = typename make_unsigned<T>::type;
+    return static_cast<double>(static_cast<U>(static_cast<U>(cfg.maxValue) - static_cast<U>(cfg.minValue))) + 1.0;
+}
+
+// log2 usable in constant expressions (std::log2 is not constexpr in C++17)
+constexpr double const_log2(double x) {
+    int e = 0;
+    while (x >= 2.0) { x /= 2.0; ++e; }
+    while (x < 1.0) { x *= 2.0; --e; }
+    // ln(x) = 2 atanh((x-1)/(x+1)), and (x-1)/(x+1) <= 1/3 here
+    double y = (x - 1.0) / (x + 1.0), y2 = y * y, term = y, sum = 0.0;
+    for (int k = 1; k < 61; k += 2) { sum += term / k; term *= y2; }
+    return e + 2.0 * sum / 0.69314718055994530942;
+}
+
+// ---------- Game rules ----------
+// A Rules type supplies the range, attempt limit and scoring base. The fixed
+// presets are PresetRules, whose members are all constexpr, so everything
+// derived from them folds at compile time in GameSession and compute_score.
+// DynamicRules wraps a runtime config for Custom (and Liar) games.
+template <typename T, T Min, T Max, int MaxAttempts>
+struct PresetRules {
+    using value_type = T;
+    static constexpr T min_value() { return Min; }
+    static constexpr T max_value() { return Max; }
+    static constexpr int max_attempts() { return MaxAttempts; }
+    static constexpr double score_base() { return 1000.0 / const_log2(static_cast<double>(Max - Min + 1) + 1.0); }
+    static constexpr double time_weight() { return 0.5; }
+};
+
+using EasyRules = PresetRules<int, 1, 20, 0>;
+using MediumRules = PresetRules<int, 1, 100, 10>;
+using HardRules = PresetRules<int, 1, 1000, 12>;
+
+template <typename T>
+struct DynamicRules {
+    using value_type = T;
+    explicit DynamicRules(const BasicGameConfig<T> &cfg)
+        : minValue(cfg.minValue), maxValue(cfg.maxValue), maxAttempts(cfg.maxAttempts),
+          base(1000.0 / log2(range_size(cfg) + 1.0)),
+          timeWeight(cfg.scoring == ScoringPolicy::Untimed ? 0.0 : 0.5) {}
+    T min_value() const { return minValue; }
+    T max_value() const { return maxValue; }
+    int max_attempts() const { return maxAttempts; }
+    double score_base() const { return base; }
+    double time_weight() const { return timeWeight; }
+
+    T minValue, maxValue;
+    int maxAttempts;
+    double base;
+    double timeWeight;
+};
+
+// Score formula
+template <typename Rules>
+double compute_score(int attempts, double secondsElapsed, const Rules &rules) {
+    double base = rules.score_base();
+    double attemptPenalty = 20.0 * (attempts - 1);
+    double timePenalty = secondsElapsed * rules.time_weight();
+    double score = base - attemptPenalty - timePenalty;
+    if (rules.max_attempts() > 0) {
+        double frac = static_cast<double>(attempts) / rules.max_attempts();
+        score *= (1.0 + max(0.0, 0.5 - frac));
+    }
+    if (score < 0) score = 0;
+    return score;
+}
+
+template <typename T>
+double compute_score(int attempts, double secondsElapsed, const BasicGameConfig<T> &cfg) {
+    return compute_score(attempts, secondsElapsed, DynamicRules<T>(cfg));
+}
+
+// Runtime config for a preset, as shown by choose_difficulty
+template <typename Rules>
+WideGameConfig preset_config(const string &name) {
+    WideGameConfig cfg;
+    cfg.difficultyName = name;
+    cfg.minValue = Rules::min_value();
+    cfg.maxValue = Rules::max_value();
+    cfg.maxAttempts = Rules::max_attempts();
+    return cfg;
+}
+
+template <typename Rules, typename T>
+bool matches_preset(const BasicGameConfig<T> &cfg) {
+    return cfg.maxLies == 0 && cfg.scoring == ScoringPolicy::Standard && cfg.minValue == Rules::min_value() && cfg.maxValue == Rules::max_value() &&
+           cfg.maxAttempts == Rules::max_attempts();
+}
+
+// ---------- Preset catalog ----------
+// Difficulty presets come from a config file (PRESETS_FILE by default), one
+// per line:
+//     name, min, max, attempts, lies, scoring
+// where attempts 0 means unlimited and scoring is "standard" or "untimed".
+// Blank lines and lines starting with '#' are ignored. A catalog is validated
+// once and then never modified; name lookup goes through a perfect hash
+// built at load time. Readers hold a shared_ptr snapshot, and a reload
+// publishes a whole new catalog atomically, so a game in progress always
+// sees one consistent catalog.
+const string PRESETS_FILE = "presets.cfg";
+
+class PresetCatalog {
+public:
+    static constexpr size_t MAX_PRESETS = 256;
+
+    // Validate `presets` and build the lookup table. On failure returns null
+    // and sets `error`.
+    static shared_ptr<const PresetCatalog> build(vector<WideGameConfig> presets, string &error) {
+        if (presets.empty()) { error = "no presets defined"; return nullptr; }
+        if (presets.size() > MAX_PRESETS) { error = "more than " + to_string(MAX_PRESETS) + " presets"; return nullptr; }
+        for (auto &p : presets) {
+            if (p.difficultyName.empty()) { error = "empty preset name"; return nullptr; }
+            if (p.minValue >= p.maxValue) { error = p.difficultyName + ": minimum must be below maximum"; return nullptr; }
+            if (p.minValue == numeric_limits<int64_t>::min() || p.maxValue == numeric_limits<int64_t>::max()) {
+                error = p.difficultyName + ": range must leave one value free at each end of int64";
+                return nullptr;
+            }
+            if (p.maxAttempts < 0) { error = p.difficultyName + ": attempts must be >= 0"; return nullptr; }
+            if (p.maxLies < 0 || p.maxLies > 3) { error = p.difficultyName + ": lies must be between 0 and 3"; return nullptr; }
+        }
+
+        shared_ptr<PresetCatalog> c(new PresetCatalog());
+        c->presets_ = move(presets);
+        size_t n = c->presets_.size(), size = 8;
+        while (size < n * n) size *= 2;   // ~60% chance per seed of no collision
+        c->slots_.assign(size, -1);
+        for (uint64_t seed = 1; seed < 100000; ++seed) {
+            bool ok = true;
+            fill(c->slots_.begin(), c->slots_.end(), -1);
+            for (size_t i = 0; i < n && ok; ++i) {
+                size_t slot = hash_name(c->presets_[i].difficultyName, seed) & (size - 1);
+                if (c->slots_[slot] >= 0) {
+                    ok = false;
+                    if (lowercase(c->presets_[c->slots_[slot]].difficultyName) == lowercase(c->presets_[i].difficultyName)) {
+                        error = "duplicate preset name: " + c->presets_[i].difficultyName;
+                        return nullptr;
+                    }
+                }
+                c->slots_[slot] = static_cast<int>(i);
+            }
+            if (ok) { c->seed_ = seed; return c; }
+        }
+        error = "could not build preset lookup table";
+        return nullptr;
+    }
+
+    const vector<WideGameConfig> &presets() const { return presets_; }
+
+    // Case-insensitive lookup by name, or null if there is no such preset
+    const WideGameConfig *find(const string &name) const {
+        int i = slots_[hash_name(name, seed_) & (slots_.size() - 1)];
+        if (i < 0 || lowercase(presets_[i].difficultyName) != lowercase(name)) return nullptr;
+        return &presets_[i];
+    }
+
+private:
+    PresetCatalog() = default;
+
+    static string lowercase(string s) {
+        for (auto &ch : s) ch = static_cast<char>(tolower(static_cast<unsigned char>(ch)));
+        return s;
+    }
+
+    // Seeded FNV-1a over the lowercased name
+    static uint64_t hash_name(const string &name, uint64_t seed) {
+        uint64_t h = 1469598103934665603ull ^ (seed * 0x9E3779B97F4A7C15ull);
+        for (unsigned char ch : name) {
+            h ^= static_cast<unsigned char>(tolower(ch));
+            h *= 1099511628211ull;
+        }
+        return h ^ (h >> 29);
+    }
+
+    vector<WideGameConfig> presets_;
+    vector<int> slots_;
+    uint64_t seed_ = 0;
+};
+
+vector<WideGameConfig> builtin_presets() {
+    WideGameConfig liar;
+    liar.difficultyName = "Liar";
+    liar.minValue = 1; liar.maxValue = 100; liar.maxAttempts = 0; liar.maxLies = 2;
+    return {preset_config<EasyRules>("Easy"), preset_config<MediumRules>("Medium"),
+            preset_config<HardRules>("Hard"), liar};
+}
+
+// Parse a preset file. Returns false with `error` set on the first bad line.
+bool parse_presets(istream &in, vector<WideGameConfig> &out, string &error) {
+    string line;
+    int lineNo = 0;
+    while (getline(in, line)) {
+        ++lineNo;
+        auto start = line.find_first_not_of(" \t\r\n");
+        if (start == string::npos || line[start] == '#') continue;
+        vector<string> fields;
+        stringstream ss(line);
+        string item;
+        while (getline(ss, item, ',')) {
+            auto b = item.find_first_not_of(" \t\r\n");
+            auto e = item.find_last_not_of(" \t\r\n");
+            fields.push_back(b == string::npos ? "" : item.substr(b, e - b + 1));
+        }
+        if (fields.size() != 6) {
+            error = "line " + to_string(lineNo) + ": expected name, min, max, attempts, lies, scoring";
+            return false;
+        }
+        WideGameConfig cfg;
+        cfg.difficultyName = fields[0];
+        try {
+            size_t idx = 0;
+            cfg.minValue = stoll(fields[1], &idx); if (idx != fields[1].size()) throw invalid_argument("min");
+            cfg.maxValue = stoll(fields[2], &idx); if (idx != fields[2].size()) throw invalid_argument("max");
+            cfg.maxAttempts = stoi(fields[3], &idx); if (idx != fields[3].size()) throw invalid_argument("attempts");
+            cfg.maxLies = stoi(fields[4], &idx); if (idx != fields[4].size()) throw invalid_argument("lies");
+        } catch (...) {
+            error = "line " + to_string(lineNo) + ": invalid number";
+            return false;
+        }
+        if (fields[5] == "standard") cfg.scoring = ScoringPolicy::Standard;
+        else if (fields[5] == "untimed") cfg.scoring = ScoringPolicy::Untimed;
+        else {
+            error = "line " + to_string(lineNo) + ": unknown scoring policy '" + fields[5] + "'";
+            return false;
+        }
+        out.push_back(cfg);
+    }
+    return true;
+}
+
+// Owns the current catalog snapshot and reloads it when the file changes
+class CatalogStore {
+public:
+    explicit CatalogStore(const string &path) : path_(path) {
+        string error;
+        current_ = PresetCatalog::build(builtin_presets(), error);
+        reload_if_changed();
+    }
+
+    shared_ptr<const PresetCatalog> snapshot() const { return atomic_load(&current_); }
+
+    const string &path() const { return path_; }
+
+    // Re-read the file if it changed; true if a new catalog was published.
+    // An invalid file keeps the previous one. The modification time alone
+    // misses a second edit within the same second on filesystems that only
+    // keep whole seconds, and an editor's save-by-rename can keep the time,
+    // so the size and inode are compared too.
+    bool reload_if_changed() {
+        struct stat st;
+        if (stat(path_.c_str(), &st) != 0) return false;
+        FileStamp stamp{st.st_mtime, 0, st.st_size, st.st_ino};
+#ifdef __linux__
+        stamp.mtimeNanos = st.st_mtim.tv_nsec;
+#endif
+        if (stamp == stamp_) return false;
+        stamp_ = stamp;
+        ifstream in(path_);
+        vector<WideGameConfig> presets;
+        string error;
+        shared_ptr<const PresetCatalog> next;
+        if (in && parse_presets(in, presets, error)) next = PresetCatalog::build(move(presets), error);
+        if (!next) {
+            log_line("Warning: ignoring " + path_ + ": " + (error.empty() ? "could not read file" : error), cerr);
+            return false;
+        }
+        atomic_store(&current_, next);
+        return true;
+    }
+
+private:
+    struct FileStamp {
+        time_t mtime;
+        long mtimeNanos;
+        off_t size;
+        ino_t inode;
+
+        bool operator==(const FileStamp &o) const {
+            return mtime == o.mtime && mtimeNanos == o.mtimeNanos && size == o.size && inode == o.inode;
+        }
+    };
+
+    string path_;
+    FileStamp stamp_{0, 0, -1, 0}; // matches no file
+    shared_ptr<const PresetCatalog> current_;
+};
+
+// ---------- Game session ----------
+// Rule-checking core of a game, free of I/O: judges guesses, keeps the hint
+// window and enforces the attempt limit.
+enum class Verdict { Correct, TooHigh, TooLow };
+
+template <typename Rules>
+class GameSession {
+public:
+    using T = typename Rules::value_type;
+
+    GameSession(const Rules &rules, T secret)
+        : rules_(rules), secret_(secret), low_(rules.min_value()), high_(rules.max_value()) {}
+
+    Verdict guess(T g) {
+        ++attempts_;
+        if (g == secret_) return Verdict::Correct;
+        if (g > secret_) {
+            if (g - 1 < high_) high_ = g - 1;
+            return Verdict::TooHigh;
+        }
+        if (g + 1 > low_) low_ = g + 1;
+        return Verdict::TooLow;
+    }
+
+    bool out_of_attempts() const { return rules_.max_attempts() > 0 && attempts_ >= rules_.max_attempts(); }
+    double score(double elapsed) const { return compute_score(max(1, attempts_), elapsed, rules_); }
+
+    // Override the hint window (the lie solver knows better than plain bounds)
+    void set_window(T low, T high) { low_ = low; high_ = high; }
+
+    // Pick up a game saved part way through
+    void restore(int attempts, T low, T high) {
+        attempts_ = attempts;
+        set_window(low, high);
+    }
+
+    const Rules &rules() const { return rules_; }
+    T secret() const { return secret_; }
+    T low() const { return low_; }
+    T high() const { return high_; }
+    int attempts() const { return attempts_; }
+
+private:
+    Rules rules_;
+    T secret_;
+    T low_, high_;
+    int attempts_ = 0;
+};
+
+// One-line description of a preset for the menu
+string describe_preset(const WideGameConfig &p) {
+    ConsoleWriter out;
+    out.pad(p.difficultyName, 7) << '(' << p.minValue << " - " << p.maxValue << ", ";
+    if (p.maxAttempts > 0) out << p.maxAttempts << " attempts";
+    else out << "unlimited attempts";
+    if (p.maxLies > 0) out << ", I may lie up to " << p.maxLies << " times";
+    if (p.scoring == ScoringPolicy::Untimed) out << ", untimed";
+    out << ')';
+    return out.take();
+}
+
+WideGameConfig choose_difficulty(const PresetCatalog &catalog) {
+    const auto &presets = catalog.presets();
+    int custom = static_cast<int>(presets.size()) + 1, adaptive = custom + 1;
+    ConsoleWriter menu;
+    menu << "Choose difficulty:\n";
+    for (size_t i = 0; i < presets.size(); ++i) menu << "  " << (i + 1) << ") " << describe_preset(presets[i]) << '\n';
+    menu << "  " << custom << ") Custom\n"
+         << "  " << adaptive << ") Adaptive (adjusts to your play)\n";
+    menu.flush();
+    int choice = prompt_int("Enter choice [1-" + to_string(adaptive) + "]: ", 1, adaptive);
+    WideGameConfig cfg;
+    if (choice < custom) {
+        cfg = presets[choice - 1];
+    } else if (choice == adaptive) {
+        cfg.difficultyName = "Adaptive";
+        cfg.adaptive = true;
+        return cfg; // AdaptiveCoach fills in the rest once it knows the player
+    } else {
+        cfg.difficultyName = "Custom";
+        // one value is kept free at each end so hint windows can step past
+        // the range without overflowing
+        cfg.minValue = prompt_value<int64_t>("Enter minimum value: ", numeric_limits<int64_t>::min() + 1,
+                                             numeric_limits<int64_t>::max() - 2);
+        cfg.maxValue = prompt_value<int64_t>("Enter maximum value: ", cfg.minValue + 1, numeric_limits<int64_t>::max() - 1);
+        if (prompt_yesno("Would you like to set a maximum attempts limit?")) {
+            cfg.maxAttempts = prompt_int("Enter maximum attempts (>=1): ", 1, 1000000);
+        } else cfg.maxAttempts = 0;
+        if (prompt_yesno("Should I be allowed to lie in my feedback?")) {
+            cfg.maxLies = prompt_int("Enter maximum lies [1-3]: ", 1, 3);
+        }
+    }
+    ConsoleWriter out;
+    out << "You selected: " << cfg.difficultyName << " (" << cfg.minValue << " - " << cfg.maxValue << ')';
+    if (cfg.maxAttempts > 0) out << ", max attempts = " << cfg.maxAttempts;
+    if (cfg.maxLies > 0) out << ", up to " << cfg.maxLies << " lies";
+    out << '\n';
+    return cfg;
+}
+
+// ---------- Lying-oracle solver (Ulam's game) ----------
+// Tracks, for every value in the range, how many of the answers so far would
+// have to be lies if that value were the secret. Values needing more than
+// maxLies lies are dead. The counts are piecewise constant, so they are kept
+// as an interval-weight vector: interval i covers [starts_[i], starts_[i+1])
+// and needs lies_[i] lies. Each answer adds at most two boundaries, so the
+// cost of an update depends on the number of guesses, never on the range.
+class LieSolver {
+public:
+    LieSolver(int64_t minValue, int64_t maxValue, int maxLies)
+        : maxLies_(maxLies), dead_(static_cast<uint8_t>(maxLies + 1)) {
+        starts_ = {minValue, maxValue + 1};
+        lies_ = {0};
+    }
+
+    // Record a wrong guess answered with "too high" (secret claimed below
+    // `guess`) or "too low" (secret claimed above it)
+    void record(int64_t guess, bool saidTooHigh) {
+        if (guess < starts_.front() || guess >= starts_.back()) {
+            // outside the range: every value agrees or disagrees at once
+            bool above = guess >= starts_.back();
+            if (above != saidTooHigh) bump(0, lies_.size());
+        } else {
+            size_t at = split(guess);
+            split(guess + 1);
+            if (saidTooHigh) bump(at, lies_.size());
+            else bump(0, at + 1);
+            lies_[at] = dead_; // a wrong guess is never the secret
+        }
+        compact();
+    }
+
+    uint64_t alive_count() const {
+        uint64_t n = 0;
+        for (size_t i = 0; i < lies_.size(); ++i)
+            if (lies_[i] < dead_) n += length(i);
+        return n;
+    }
+    int64_t alive_min() const { return starts_.front(); }   // ends are trimmed in compact()
+    int64_t alive_max() const { return starts_.back() - 1; }
+
+    // Suggest the next guess: the weighted median of the live values, each
+    // weighted by Berlekamp's volume (how many answer sequences of the
+    // remaining questions it can still absorb). Pass 0 if unlimited.
+    int64_t suggest(int questionsLeft) const {
+        uint64_t alive = alive_count();
+        if (alive == 0) return starts_.front();
+        int q = questionsLeft;
+        if (q <= 0) {
+            q = maxLies_ * 2;
+            while ((uint64_t(1) << min(q, 62)) < alive && q < 62) ++q;
+        }
+        array<double, 4> volume{};
+        for (int l = 0; l <= maxLies_ && l < 4; ++l) volume[l] = volume_of(q, maxLies_ - l);
+
+        double total = 0;
+        for (size_t i = 0; i < lies_.size(); ++i)
+            if (lies_[i] < dead_) total += volume[lies_[i]] * static_cast<double>(length(i));
+        double half = total / 2, acc = 0;
+        for (size_t i = 0; i < lies_.size(); ++i) {
+            if (lies_[i] >= dead_) continue;
+            double w = volume[lies_[i]];
+            double len = static_cast<double>(length(i));
+            if (acc + w * len >= half) {
+                uint64_t step = min(static_cast<uint64_t>((half - acc) / w), length(i) - 1);
+                return static_cast<int64_t>(static_cast<uint64_t>(starts_[i]) + step);
+            }
+            acc += w * len;
+        }
+        return alive_max();
+    }
+
+private:
+    uint64_t length(size_t i) const {
+        return static_cast<uint64_t>(starts_[i + 1]) - static_cast<uint64_t>(starts_[i]);
+    }
+
+    static double volume_of(int q, int lies) {
+        double sum = 0, c = 1;
+        for (int j = 0; j <= lies && j <= q; ++j) {
+            sum += c;
+            c = c * (q - j) / (j + 1);
+        }
+        return sum;
+    }
+
+    // Ensure an interval starts exactly at x; returns its index
+    size_t split(int64_t x) {
+        auto it = upper_bound(starts_.begin(), starts_.end(), x);
+        size_t i = static_cast<size_t>(it - starts_.begin()) - 1;
+        if (starts_[i] == x) return i;
+        starts_.insert(starts_.begin() + i + 1, x);
+        lies_.insert(lies_.begin() + i + 1, lies_[i]);
+        return i + 1;
+    }
+
+    // Saturating increment of lies_[from, to); a plain loop over bytes that
+    // the compiler turns into SIMD adds
+    void bump(size_t from, size_t to) {
+        uint8_t *p = lies_.data();
+        const uint8_t cap = dead_;
+        for (size_t i = from; i < to; ++i) p[i] = static_cast<uint8_t>(p[i] < cap ? p[i] + 1 : cap);
+    }
+
+    // Merge equal neighbours and trim dead intervals off both ends
+    void compact() {
+        size_t w = 0;
+        for (size_t i = 0; i < lies_.size(); ++i) {
+            if (w > 0 && lies_[w - 1] == lies_[i]) continue;
+            starts_[w] = starts_[i];
+            lies_[w] = lies_[i];
+            ++w;
+        }
+        starts_[w] = starts_.back();
+        starts_.resize(w + 1);
+        lies_.resize(w);
+        while (lies_.size() > 1 && lies_.back() >= dead_) { lies_.pop_back(); starts_.pop_back(); }
+        while (lies_.size() > 1 && lies_.front() >= dead_) { lies_.erase(lies_.begin()); starts_.erase(starts_.begin()); }
+    }
+
+    int maxLies_;
+    uint8_t dead_;
+    vector<int64_t> starts_;
+    vector<uint8_t> lies_;
+};
+
+// ---------- Repeat detection ----------
+// Set of guessed values as a Roaring-style compressed bitmap: values are
+// bucketed by their high bits, and each bucket holds its low 16 bits either
+// as a sorted uint16 array (sparse) or as a 64 Kbit bitmap once it passes
+// 4096 entries. Memory follows the number of guesses, not the range, so a
+// full-int Custom range costs a few bytes per guess.
+class GuessSet {
+public:
+    // Returns false if `value` was already in the set
+    bool insert(int64_t value) {
+        uint64_t v = static_cast<uint64_t>(value) ^ (uint64_t(1) << 63); // order-preserving
+        uint64_t key = v >> 16;
+        uint16_t low = static_cast<uint16_t>(v & 0xFFFF);
+        auto it = lower_bound(keys_.begin(), keys_.end(), key);
+        size_t i = static_cast<size_t>(it - keys_.begin());
+        if (it == keys_.end() || *it != key) {
+            keys_.insert(it, key);
+            containers_.insert(containers_.begin() + i, Container());
+        }
+        Container &c = containers_[i];
+        if (!c.bits.empty()) {
+            uint64_t mask = uint64_t(1) << (low & 63);
+            if (c.bits[low >> 6] & mask) return false;
+            c.bits[low >> 6] |= mask;
+        } else {
+            auto pos = lower_bound(c.values.begin(), c.values.end(), low);
+            if (pos != c.values.end() && *pos == low) return false;
+            c.values.insert(pos, low);
+            if (c.values.size() > ARRAY_LIMIT) to_bitmap(c);
+        }
+        ++size_;
+        return true;
+    }
+
+    size_t size() const { return size_; }
+
+private:
+    static constexpr size_t ARRAY_LIMIT = 4096;
+
+    struct Container {
+        vector<uint16_t> values; // sorted, while sparse
+        vector<uint64_t> bits;   // 1024 words once dense
+    };
+
+    static void to_bitmap(Container &c) {
+        c.bits.assign(1024, 0);
+        for (uint16_t low : c.values) c.bits[low >> 6] |= uint64_t(1) << (low & 63);
+        vector<uint16_t>().swap(c.values);
+    }
+
+    vector<uint64_t> keys_;
+    vector<Container> containers_;
+    size_t size_ = 0;
+};
+
+template <typename T>
+string difficulty_label(const BasicGameConfig<T> &cfg) {
+    return cfg.difficultyName + " (" + to_string(cfg.minValue) + "-" + to_string(cfg.maxValue) + ")";
+}
+
+// Ask for the player's name (unless already known) and record the finished game
+Result finish_game(const string &difficulty, int attempts, double elapsed, int64_t secret, double score,
+                   const string &knownName) {
+    Result res;
+    string name = knownName;
+    if (name.empty()) {
+        cout << "\nEnter your name for the leaderboard (leave blank to skip): ";
+        cout.flush();
+        name = safe_getline();
+    }
+    if (name.empty()) name = "Anonymous";
+    res.playerName = name;
+    res.difficulty = difficulty;
+    res.attempts = attempts;
+    res.elapsedSeconds = elapsed;
+    res.secretNumber = secret;
+    res.timestamp = now_iso8601();
+    res.score = score;
+
+    if (name != "Anonymous") append_to_leaderboard(res);
+    return res;
+}
+
+template <typename T, typename Rules>
+Result play_game(const BasicGameConfig<T> &cfg, const Rules &rules) {
+    GameSession<Rules> session(rules, random_int(rules.min_value(), rules.max_value()));
+    const T secret = session.secret();
+    int liesLeft = cfg.maxLies;
+    unique_ptr<LieSolver> solver;
+    if (cfg.maxLies > 0) solver.reset(new LieSolver(cfg.minValue, cfg.maxValue, cfg.maxLies));
+    GuessSet guessed;
+    int repeats = 0, outOfWindow = 0;
+    bool won = false, timedOut = false;
+
+    ConsoleWriter out;
+    out << "\nI have selected a number between " << rules.min_value() << " and " << rules.max_value() << ".\n";
+    if (rules.max_attempts() > 0) out << "You have up to " << rules.max_attempts() << " attempts.\n";
+    if (cfg.maxLies > 0) out << "Careful: up to " << cfg.maxLies << " of my hints may be lies.\n";
+    if (cfg.timeLimitSeconds > 0) out << "You have " << cfg.timeLimitSeconds << " seconds.\n";
+    out << "Type your guess and press Enter.\n";
+    out.flush();
+
+    auto start = Clock::now();
+    auto deadline = game_deadline(start, cfg.timeLimitSeconds);
+    string prompt;
+    while (true) {
+        // the whole prompt line is one write, and is shown again on bad input
+        if (solver) {
+            int left = rules.max_attempts() > 0 ? rules.max_attempts() - session.attempts() : 0;
+            out << "Possible: " << solver->alive_count() << " values, try " << solver->suggest(left) << ". ";
+        }
+        out << "Allowed range: [" << session.low() << " - " << session.high() << "] Enter guess (or q to give up): ";
+        prompt = out.str();
+        out.clear();
+        T guess{};
+        bool answered = prompt_guess<T>(prompt, numeric_limits<T>::min(), numeric_limits<T>::max(), guess, deadline);
+
+        if (Clock::now() >= deadline) {
+            cout << "Time's up (" << cfg.timeLimitSeconds << " seconds). You lose. The number was " << secret << ".\n";
+            timedOut = true;
+            break;
+        }
+        if (!answered) {
+            cout << "You gave up. The number was " << secret << ".\n";
+            break;
+        }
+
+        if (cfg.detectRepeats) {
+            if (!guessed.insert(guess)) {
+                ++repeats;
+                cout << "You already guessed " << guess << ". ";
+            } else if (guess < session.low() || guess > session.high()) {
+                ++outOfWindow;
+                cout << "That's outside the allowed range. ";
+            }
+        }
+
+        Verdict verdict = session.guess(guess);
+        if (verdict == Verdict::Correct) {
+            cout << "Congratulations! You guessed correctly in " << session.attempts() << " attempts.\n";
+            won = true;
+            break;
+        } else if (solver) {
+            bool tooHigh = verdict == Verdict::TooHigh;
+            if (liesLeft > 0 && random_int(0, 2) == 0) { tooHigh = !tooHigh; --liesLeft; }
+            cout << (tooHigh ? "Too high.\n" : "Too low.\n");
+            solver->record(guess, tooHigh);
+            session.set_window(static_cast<T>(solver->alive_min()), static_cast<T>(solver->alive_max()));
+        } else if (verdict == Verdict::TooHigh) {
+            cout << "Too high.\n";
+        } else {
+            cout << "Too low.\n";
+        }
+
+        if (session.out_of_attempts()) {
+            cout << "Reached maximum attempts (" << rules.max_attempts() << "). You lose. The number was " << secret << ".\n";
+            break;
+        }
+    }
+    auto end = Clock::now();
+    double elapsed = chrono::duration_cast<chrono::duration<double>>(end - start).count();
+    if (timedOut) elapsed = cfg.timeLimitSeconds; // the game ended when the clock ran out
+
+    Result res = finish_game(difficulty_label(cfg), session.attempts(), elapsed, secret,
+                             timedOut ? 0.0 : session.score(elapsed), cfg.playerName);
+    res.won = won;
+    res.repeats = repeats;
+    res.outOfWindow = outOfWindow;
+    return res;
+}
+
+// Presets get their compile-time rules; everything else runs on the config
+template <typename T>
+Result play_game(const BasicGameConfig<T> &cfg) {
+    if constexpr (is_same<T, int>::value) {
+        if (matches_preset<EasyRules>(cfg)) return play_game(cfg, EasyRules());
+        if (matches_preset<MediumRules>(cfg)) return play_game(cfg, MediumRules());
+        if (matches_preset<HardRules>(cfg)) return play_game(cfg, HardRules());
+    }
+    return play_game(cfg, DynamicRules<T>(cfg));
+}
+
+// ---------- Multi-secret mode ----------
+// The player hunts K distinct secrets. Every guess reports how many secrets
+// lie below and above it. SegmentTracker remembers each probe with the number
+// of secrets below it; consecutive probes bound a segment whose unfound count
+// is known exactly, so each guess is one O(log n) ordered-map insert.
+class SegmentTracker {
+public:
+    SegmentTracker(int64_t minValue, int64_t maxValue, int64_t secrets) {
+        probes_[minValue - 1] = {0, false};
+        probes_[maxValue + 1] = {secrets, false};
+        openSegments_ = secrets > 0 ? 1 : 0;
+    }
+
+    // Record a probe at `value` with `below` secrets strictly under it.
+    // Returns the number of unfound secrets still in the segment to its left
+    // and to its right.
+    pair<int64_t, int64_t> record(int64_t value, int64_t below, bool hit) {
+        auto right = probes_.lower_bound(value);
+        if (right->first == value) return {unknown_between(prev(right), right), unknown_between(right, next(right))};
+        auto left = prev(right);
+        if (unknown_between(left, right) > 0) --openSegments_;
+        auto mid = probes_.emplace_hint(right, value, Probe{below, hit});
+        int64_t l = unknown_between(left, mid), r = unknown_between(mid, right);
+        openSegments_ += (l > 0) + (r > 0);
+        return {l, r};
+    }
+
+    int64_t open_segments() const { return openSegments_; }
+
+private:
+    struct Probe { int64_t below; bool hit; };
+    using Iter = map<int64_t, Probe>::const_iterator;
+
+    static int64_t unknown_between(Iter l, Iter r) {
+        return r->second.below - l->second.below - (l->second.hit ? 1 : 0);
+    }
+
+    map<int64_t, Probe> probes_;
+    int64_t openSegments_;
+};
+
+template <typename T>
+Result play_multi_game(const BasicGameConfig<T> &cfg) {
+    using U = typename make_unsigned<T>::type;
+    uint64_t span = static_cast<uint64_t>(static_cast<U>(static_cast<U>(cfg.maxValue) - static_cast<U>(cfg.minValue))) + 1;
+    int maxSecrets = static_cast<int>(min<uint64_t>(10000, span));
+    int k = prompt_int("How many secret numbers [1-" + to_string(maxSecrets) + "]: ", 1, maxSecrets);
+
+    // Floyd's sampling: k distinct values without touching the whole range
+    vector<T> secrets;
+    {
+        map<uint64_t, bool> chosen;
+        for (uint64_t j = span - k; j < span; ++j) {
+            uint64_t t = random_int<uint64_t>(0, j);
+            if (chosen.count(t)) t = j;
+            chosen[t] = true;
+        }
+        for (auto &c : chosen) secrets.push_back(static_cast<T>(static_cast<U>(cfg.minValue) + static_cast<U>(c.first)));
+    }
+    vector<bool> found(secrets.size(), false);
+    SegmentTracker tracker(cfg.minValue, cfg.maxValue, k);
+    GuessSet guessed;
+    int repeats = 0;
+    int maxAttempts = cfg.maxAttempts > 0 ? cfg.maxAttempts * k : 0;
+
+    cout << "\nI have selected " << k << " different numbers between " << cfg.minValue << " and " << cfg.maxValue << ".\n";
+    if (maxAttempts > 0) cout << "You have up to " << maxAttempts << " attempts.\n";
+    if (cfg.timeLimitSeconds > 0) cout << "You have " << cfg.timeLimitSeconds << " seconds.\n";
+    if (cfg.maxLies > 0) cout << "(No lies in this mode.)\n";
+    cout << "After each guess I'll tell you how many of my numbers are below and above it.\n";
+
+    int attempts = 0, foundCount = 0;
+    auto start = Clock::now();
+    auto deadline = game_deadline(start, cfg.timeLimitSeconds);
+    while (foundCount < k) {
+        cout << "Found " << foundCount << "/" << k << ", " << tracker.open_segments() << " open segments. ";
+        cout.flush();
+        // the tracker's sentinels sit just outside the range, so guesses must stay inside it
+        T guess{};
+        bool answered = prompt_guess<T>("Enter guess (or q to give up): ", cfg.minValue, cfg.maxValue, guess, deadline);
+        if (Clock::now() >= deadline) {
+            cout << "Time's up (" << cfg.timeLimitSeconds << " seconds). You lose with " << (k - foundCount) << " numbers left.\n";
+            break;
+        }
+        if (!answered) {
+            cout << "You gave up with " << (k - foundCount) << " numbers left.\n";
+            break;
+        }
+        attempts++;
+        if (cfg.detectRepeats && !guessed.insert(guess)) {
+            ++repeats;
+            cout << "You already guessed " << guess << ". ";
+        }
+
+        auto it = lower_bound(secrets.begin(), secrets.end(), guess);
+        int64_t below = it - secrets.begin();
+        bool hit = it != secrets.end() && *it == guess;
+        int64_t above = k - below - (hit ? 1 : 0);
+        auto unknown = tracker.record(guess, below, hit);
+        if (hit && !found[below]) {
+            found[below] = true;
+            ++foundCount;
+            cout << "Hit! ";
+        } else if (hit) {
+            cout << "Already found. ";
+        }
+        cout << below << " below, " << above << " above";
+        cout << " (unfound: " << unknown.first << " just below, " << unknown.second << " just above).\n";
+
+        if (maxAttempts > 0 && attempts >= maxAttempts && foundCount < k) {
+            cout << "Reached maximum attempts (" << maxAttempts << "). You lose with " << (k - foundCount) << " numbers left.\n";
+            break;
+        }
+    }
+    if (foundCount == k) cout << "Congratulations! You found all " << k << " numbers in " << attempts << " attempts.\n";
+    double elapsed = chrono::duration_cast<chrono::duration<double>>(Clock::now() - start).count();
+    if (cfg.timeLimitSeconds > 0) elapsed = min(elapsed, static_cast<double>(cfg.timeLimitSeconds));
+
+    // Score as if each secret were its own game
+    int perSecret = max(1, (attempts + k - 1) / k);
+    double score = foundCount == k ? compute_score(perSecret, elapsed / k, cfg) : 0.0;
+    Result res = finish_game(difficulty_label(cfg) + " x" + to_string(k), attempts, elapsed, secrets.front(), score,
+                             cfg.playerName);
+    res.won = foundCount == k;
+    res.repeats = repeats;
+    return res;
+}
+
+// ---------- Reverse mode: decision trees ----------
+// The computer's guesses come from a decision tree stored flat in BFS
+// (Eytzinger) order: node i's children are 2i+1 ("too high") and 2i+2
+// ("too low"), and each slot holds the guess as an offset from minValue, or
+// TREE_EMPTY. A serialized tree is a TreeHeader followed by the slots, with
+// no pointers, so the blob is written out and mmap'd as is.
+//
+// The presets' trees are built at compile time. A Custom range is first
+// played on a computed tree, which derives each guess from the answers that
+// led to it, so the first move costs O(1) even for 10^6 values. Once that
+// game is over its flat tree is written to TREE_CACHE_DIR, and later games
+// on the range map the file. decision_tree_for keeps the last few Custom
+// trees in memory.
+//
+// Guessing the midpoint of the remaining window is optimal for both goals we
+// care about: with enough attempts it minimises the expected number of
+// guesses, and with too few it still covers the maximum 2^attempts - 1 values.
+constexpr uint32_t TREE_EMPTY = 0xFFFFFFFFu;
+constexpr uint32_t TREE_MAGIC = 0x45455254u; // "TREE"
+const string TREE_CACHE_DIR = "decision_trees";
+
+struct TreeHeader {
+    uint32_t magic;
+    uint32_t depth;
+    uint64_t span;
+    uint64_t nodeCount;
+};
+
+// Depth of the tree: enough levels to cover `span` values, capped by the
+// attempt limit (0 means unlimited)
+constexpr uint32_t tree_depth(uint64_t span, int maxAttempts) {
+    uint32_t d = 0;
+    while (((uint64_t(1) << d) - 1) < span) ++d;
+    if (maxAttempts > 0 && static_cast<uint32_t>(maxAttempts) < d) d = static_cast<uint32_t>(maxAttempts);
+    return d;
+}
+
+// Slots: a std::array at compile time, a vector when a Custom tree is stored
+template <typename Slots>
+constexpr void fill_tree(Slots &slots, size_t node, int64_t lo, int64_t hi) {
+    if (node >= slots.size() || lo > hi) return;
+    int64_t mid = lo + (hi - lo) / 2;
+    slots[node] = static_cast<uint32_t>(mid);
+    fill_tree(slots, 2 * node + 1, lo, mid - 1);
+    fill_tree(slots, 2 * node + 2, mid + 1, hi);
+}
+
+// Built at compile time for the fixed presets in choose_difficulty
+template <uint64_t Span, int MaxAttempts>
+struct PresetTree {
+    static constexpr uint32_t depth = tree_depth(Span, MaxAttempts);
+    static constexpr size_t nodeCount = (size_t(1) << depth) - 1;
+    static constexpr array<uint32_t, nodeCount> build() {
+        array<uint32_t, nodeCount> slots{};
+        for (size_t i = 0; i < nodeCount; ++i) slots[i] = TREE_EMPTY;
+        fill_tree(slots, 0, 0, static_cast<int64_t>(Span) - 1);
+        return slots;
+    }
+    static constexpr array<uint32_t, nodeCount> slots = build();
+};
+
+class DecisionTree {
+public:
+    // View over flat slots: a compile-time preset, or a blob kept alive by
+    // `storage` (a mapping or a buffer)
+    DecisionTree(const uint32_t *slots, uint64_t span, uint32_t depth, shared_ptr<const void> storage = nullptr)
+        : span_(span), depth_(depth), fixed_(slots), storage_(move(storage)) {}
+
+    // Computed tree: O(1) memory whatever the range
+    DecisionTree(uint64_t span, uint32_t depth) : span_(span), depth_(depth), fixed_(nullptr) {}
+
+    // View a serialized blob that `storage` keeps alive, or null if the blob
+    // is malformed
+    static shared_ptr<DecisionTree> from_blob(shared_ptr<const void> storage, const void *data, size_t size) {
+        if (size < sizeof(TreeHeader)) return nullptr;
+        TreeHeader h;
+        memcpy(&h, data, sizeof h);
+        if (h.magic != TREE_MAGIC || h.span == 0 || h.span >= TREE_EMPTY || h.depth >= 40 || h.nodeCount != (uint64_t(1) << h.depth) - 1 ||
+            h.depth != tree_depth(h.span, static_cast<int>(h.depth)))
+            return nullptr;
+        if (size != sizeof(TreeHeader) + h.nodeCount * sizeof(uint32_t)) return nullptr;
+        auto slots = reinterpret_cast<const uint32_t *>(static_cast<const char *>(data) + sizeof(TreeHeader));
+        return make_shared<DecisionTree>(slots, h.span, h.depth, move(storage));
+    }
+
+    uint32_t depth() const { return depth_; }
+    uint64_t span() const { return span_; }
+    size_t node_count() const { return (size_t(1) << depth_) - 1; }
+    bool flat() const { return fixed_ != nullptr; }
+
+    // Guess offset stored at `node`, or TREE_EMPTY if no value is left there.
+    // A computed tree keeps the window of the node asked last, since a game
+    // walks downwards: a child of it costs O(1), any other node O(depth).
+    uint32_t guess_at(size_t node) {
+        if (node >= node_count()) return TREE_EMPTY;
+        if (fixed_) return fixed_[node];
+        int64_t lo = 0, hi = static_cast<int64_t>(span_) - 1;
+        if (node > 0 && lastNode_ == (node - 1) / 2) {
+            lo = lastLo_;
+            hi = lastHi_;
+            descend(lo, hi, node % 2 == 0);
+        } else {
+            // bits of node + 1 below its leading one: 0 = "too high", 1 = "too low"
+            uint64_t path = node + 1;
+            int bits = 63 - __builtin_clzll(path);
+            for (int b = bits - 1; b >= 0; --b) descend(lo, hi, (path >> b) & 1);
+        }
+        lastNode_ = node;
+        lastLo_ = lo;
+        lastHi_ = hi;
+        return lo > hi ? TREE_EMPTY : static_cast<uint32_t>(lo + (hi - lo) / 2);
+    }
+
+    // Header and every slot; a computed tree is laid out flat first
+    bool write_blob(ostream &os) const {
+        TreeHeader h{TREE_MAGIC, depth_, span_, node_count()};
+        os.write(reinterpret_cast<const char *>(&h), sizeof h);
+        if (fixed_) {
+            os.write(reinterpret_cast<const char *>(fixed_), static_cast<streamsize>(h.nodeCount * sizeof(uint32_t)));
+        } else {
+            vector<uint32_t> slots(h.nodeCount, TREE_EMPTY);
+            fill_tree(slots, 0, 0, static_cast<int64_t>(span_) - 1);
+            os.write(reinterpret_cast<const char *>(slots.data()), static_cast<streamsize>(slots.size() * sizeof(uint32_t)));
+        }
+        return static_cast<bool>(os);
+    }
+
+private:
+    // Narrow [lo, hi] past its midpoint guess
+    static void descend(int64_t &lo, int64_t &hi, bool tooLow) {
+        if (lo > hi) return;
+        int64_t mid = lo + (hi - lo) / 2;
+        if (tooLow) lo = mid + 1;
+        else hi = mid - 1;
+    }
+
+    uint64_t span_;
+    uint32_t depth_;
+    const uint32_t *fixed_;
+    shared_ptr<const void> storage_;
+    size_t lastNode_ = SIZE_MAX;
+    int64_t lastLo_ = 0, lastHi_ = -1;
+};
+
+// Map a tree written by DecisionTree::write_blob; null if missing or malformed
+shared_ptr<DecisionTree> load_tree_file(const string &path) {
+#ifdef __linux__
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return nullptr;
+    struct stat st;
+    size_t size = 0;
+    void *mem = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && static_cast<size_t>(st.st_size) >= sizeof(TreeHeader)) {
+        size = static_cast<size_t>(st.st_size);
+        mem = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    }
+    ::close(fd);
+    if (mem == MAP_FAILED) return nullptr;
+    shared_ptr<const void> mapping(mem, [size](const void *p) { munmap(const_cast<void *>(p), size); });
+    return DecisionTree::from_blob(mapping, mem, size);
+#else
+    ifstream in(path, ios::binary | ios::ate);
+    if (!in) return nullptr;
+    size_t size = static_cast<size_t>(in.tellg());
+    auto buffer = make_shared<vector<uint32_t>>((size + 3) / 4); // slot-aligned
+    in.seekg(0);
+    if (!in.read(reinterpret_cast<char *>(buffer->data()), static_cast<streamsize>(size))) return nullptr;
+    return DecisionTree::from_blob(buffer, buffer->data(), size);
+#endif
+}
+
+// Trees for Custom ranges: the last few in memory, flat ones on disk
+class TreeCache {
+public:
+    static constexpr size_t MEMORY_TREES = 8;
+    static constexpr uint32_t MAX_STORED_DEPTH = 22; // 16 MB of slots; deeper trees are only computed
+
+    shared_ptr<DecisionTree> get(uint64_t span, int maxAttempts) {
+        Key key{span, maxAttempts};
+        for (auto it = recent_.begin(); it != recent_.end(); ++it)
+            if (it->first == key) {
+                recent_.splice(recent_.begin(), recent_, it);
+                return it->second;
+            }
+        shared_ptr<DecisionTree> tree = load_tree_file(file_for(key));
+        if (!tree || tree->span() != span || tree->depth() != tree_depth(span, maxAttempts))
+            tree = make_shared<DecisionTree>(span, tree_depth(span, maxAttempts));
+        recent_.emplace_front(key, tree);
+        if (recent_.size() > MEMORY_TREES) recent_.pop_back();
+        return tree;
+    }
+
+    // After a game on a computed tree, write its flat form for next time and
+    // use the mapped copy from now on. Failing to store only costs speed.
+    void store(uint64_t span, int maxAttempts) {
+        Key key{span, maxAttempts};
+        auto it = find_if(recent_.begin(), recent_.end(), [&](const Entry &e) { return e.first == key; });
+        if (it == recent_.end() || it->second->flat() || it->second->depth() > MAX_STORED_DEPTH) return;
+#ifdef __linux__
+        mkdir(TREE_CACHE_DIR.c_str(), 0755);
+#endif
+        string path = file_for(key), tmp = path + ".tmp";
+        ofstream out(tmp, ios::binary | ios::trunc);
+        bool written = out && it->second->write_blob(out);
+        out.close();
+        if (!written || !out || rename(tmp.c_str(), path.c_str()) != 0) {
+            remove(tmp.c_str());
+            return;
+        }
+        if (auto mapped = load_tree_file(path)) it->second = mapped;
+    }
+
+private:
+    using Key = pair<uint64_t, int>;
+    using Entry = pair<Key, shared_ptr<DecisionTree>>;
+
+    static string file_for(const Key &key) {
+        return TREE_CACHE_DIR + "/" + to_string(key.first) + "-" + to_string(key.second) + ".tree";
+    }
+
+    list<Entry> recent_; // most recently used first
+};
+
+TreeCache &custom_trees() {
+    static TreeCache cache;
+    return cache;
+}
+
+uint64_t tree_span(const GameConfig &cfg) {
+    return static_cast<uint64_t>(static_cast<int64_t>(cfg.maxValue) - cfg.minValue + 1);
+}
+
+// Compile-time trees for the presets, the Custom cache otherwise
+shared_ptr<DecisionTree> decision_tree_for(const GameConfig &cfg) {
+    using EasyTree = PresetTree<20, 0>;
+    using MediumTree = PresetTree<100, 10>;
+    using HardTree = PresetTree<1000, 12>;
+
+    uint64_t span = tree_span(cfg);
+    if (span == 20 && cfg.maxAttempts == 0) return make_shared<DecisionTree>(EasyTree::slots.data(), 20, EasyTree::depth);
+    if (span == 100 && cfg.maxAttempts == 10)
+        return make_shared<DecisionTree>(MediumTree::slots.data(), 100, MediumTree::depth);
+    if (span == 1000 && cfg.maxAttempts == 12)
+        return make_shared<DecisionTree>(HardTree::slots.data(), 1000, HardTree::depth);
+    return custom_trees().get(span, cfg.maxAttempts);
+}
+
+// The player thinks of a number and the computer walks the decision tree
+void play_reverse_game(const GameConfig &cfg) {
+    shared_ptr<DecisionTree> tree = decision_tree_for(cfg);
+    cout << "\nThink of a number between " << cfg.minValue << " and " << cfg.maxValue << ".\n";
+    if (cfg.maxAttempts > 0) cout << "I have up to " << cfg.maxAttempts << " attempts.\n";
+    cout << "Answer each guess with h (too high), l (too low) or c (correct).\n";
+
+    size_t node = 0;
+    int attempts = 0;
+    while (true) {
+        uint32_t offset = tree->guess_at(node);
+        if (offset == TREE_EMPTY) {
+            if (node >= tree->node_count() && cfg.maxAttempts > 0 && attempts >= cfg.maxAttempts)
+                cout << "I'm out of attempts (" << cfg.maxAttempts << "). You win!\n";
+            else
+                cout << "Your answers are inconsistent - no number in range fits them.\n";
+            break;
+        }
+        attempts++;
+        int guess = static_cast<int>(cfg.minValue + static_cast<int64_t>(offset));
+        char c = prompt_choice("Is it " + to_string(guess) + "? [h/l/c]: ", "hlc");
+        if (c == 'c') {
+            cout << "Got it! Your number is " << guess << " (" << attempts << " attempts).\n";
+            break;
+        }
+        node = 2 * node + (c == 'h' ? 1 : 2);
+    }
+    if (!tree->flat()) custom_trees().store(tree_span(cfg), cfg.maxAttempts);
+}
+
+// ---------- Adaptive difficulty ----------
+// Running estimates, each an EWMA updated in O(1) after a game. Per player
+// and range bucket (log2 of the range size, rounded), so a game on 1..10
+// says nothing about 1..10^6:
+//   attemptRatio    - attempts used / optimal (log2 of the range) guesses
+//   secondsPerGuess - seconds spent per optimal guess
+// and per player:
+//   winRate         - recent win rate
+// `level` is log2 of the range size. After each game it moves by how far
+// the recent win rate is from TARGET_WIN_RATE, so it settles where the two
+// match. The step is scaled by the game's pace against the bucket's usual
+// seconds per guess, so a quick win raises it more and a quick loss lowers
+// it less. The attempt limit follows the attempt ratio at the chosen range.
+// Every update appends one row to PLAYER_STATS_FILE (the latest row per
+// player and bucket wins), with the name quoted like the leaderboard's. The
+// file is only read the first time an adaptive game is played, so startup
+// never pays for it, and is compacted to the live rows then once superseded
+// rows outnumber them.
+const string PLAYER_STATS_FILE = "player_stats.csv";
+
+struct RangeStats {
+    double attemptRatio = 1.5;
+    double secondsPerGuess = 5.0;
+    int games = 0;
+};
+
+struct PlayerStats {
+    double level = 4.4;          // ~20 values, like Easy
+    double winRate = 0.7;
+    int games = 0;
+    map<int, RangeStats> ranges; // by range_bucket
+
+    // This bucket's estimates, else the nearest bucket played, else defaults
+    const RangeStats &near(int bucket) const {
+        static const RangeStats defaults;
+        const RangeStats *best = &defaults;
+        int bestDistance = numeric_limits<int>::max();
+        for (auto &r : ranges)
+            if (r.second.games > 0 && abs(r.first - bucket) < bestDistance) {
+                bestDistance = abs(r.first - bucket);
+                best = &r.second;
+            }
+        return *best;
+    }
+};
+
+int range_bucket(double span) { return static_cast<int>(lround(log2(max(2.0, span)))); }
+
+class AdaptiveCoach {
+public:
+    static constexpr double TARGET_WIN_RATE = 0.7;
+    static constexpr double ALPHA = 0.3;      // EWMA weight of the newest game
+    static constexpr double LEVEL_STEP = 2.0;  // level change per unit of win rate off target
+
+    explicit AdaptiveCoach(const string &path) : path_(path) {}
+
+    // Range and attempt limit for this player's next game
+    WideGameConfig next_config(const string &player) {
+        const PlayerStats &st = stats_for(player);
+        WideGameConfig cfg;
+        cfg.difficultyName = "Adaptive";
+        cfg.adaptive = true;
+        cfg.playerName = player;
+        cfg.minValue = 1;
+        cfg.maxValue = max<int64_t>(2, llround(exp2(st.level)));
+        double optimal = ceil(log2(static_cast<double>(cfg.maxValue) + 1.0));
+        double ratio = st.near(range_bucket(range_size(cfg))).attemptRatio;
+        cfg.maxAttempts = static_cast<int>(ceil(max(1.0, ratio) * optimal)) + 1;
+        return cfg;
+    }
+
+    void record(const WideGameConfig &cfg, const Result &r) {
+        PlayerStats &st = stats_for(cfg.playerName);
+        int bucket = range_bucket(range_size(cfg));
+        auto slot = st.ranges.emplace(bucket, st.near(bucket)); // new buckets start from the nearest
+        RangeStats &range = slot.first->second;
+        if (slot.second) range.games = 0;
+        double optimal = max(1.0, ceil(log2(range_size(cfg) + 1.0)));
+        double secondsPerGuess = r.elapsedSeconds / optimal;
+        // > 1 when this game went faster than usual at this range
+        double pace = min(2.0, max(0.5, range.secondsPerGuess / max(0.01, secondsPerGuess)));
+
+        if (r.won) range.attemptRatio += ALPHA * (r.attempts / optimal - range.attemptRatio);
+        range.secondsPerGuess += ALPHA * (secondsPerGuess - range.secondsPerGuess);
+        range.games++;
+        st.winRate += ALPHA * ((r.won ? 1.0 : 0.0) - st.winRate);
+        double step = LEVEL_STEP * (st.winRate - TARGET_WIN_RATE);
+        st.level = min(40.0, max(3.0, st.level + (step > 0 ? step * pace : step / pace)));
+        st.games++;
+
+        ofstream ofs(path_, ios::app);
+        if (!ofs || !(write_row(ofs, cfg.playerName, st, bucket), ofs.flush())) {
+            cerr << "Warning: could not write player stats file.\n";
+            return;
+        }
+        ++rows_;
+    }
+
+    const PlayerStats &stats_for_display(const string &player) { return stats_for(player); }
+
+private:
+    PlayerStats &stats_for(const string &player) {
+        if (!loaded_) load();
+        return stats_[player];
+    }
+
+    // "player",level,winRate,games,bucket,attemptRatio,secondsPerGuess,bucketGames
+    static void write_row(ostream &os, const string &player, const PlayerStats &st, int bucket) {
+        const RangeStats &range = st.ranges.at(bucket);
+        vector<char> buf(2 * player.size() + 192);
+        char *end = buf.data() + buf.size();
+        char *p = put_csv_quoted(buf.data(), end, player);
+        p = put_csv_number(p, end, st.level, ',');
+        p = put_csv_number(p, end, st.winRate, ',');
+        p = put_csv_number(p, end, st.games, ',');
+        p = put_csv_number(p, end, bucket, ',');
+        p = put_csv_number(p, end, range.attemptRatio, ',');
+        p = put_csv_number(p, end, range.secondsPerGuess, ',');
+        p = put_csv_number(p, end, range.games, '\n');
+        if (p) os.write(buf.data(), p - buf.data());
+        else os.setstate(ios::failbit);
+    }
+
+    // Applies one row to `stats_`. Rows from before stats were kept per range
+    // (level,attemptRatio[,secondsPerGuess],winRate,games) count as the
+    // bucket of their level.
+    bool apply_row(const string &line) {
+        size_t pos = 0;
+        string player, item;
+        vector<double> f;
+        if (line.empty() || line == "\r" || !next_csv_field(line, pos, player)) return false;
+        try {
+            while (next_csv_field(line, pos, item)) f.push_back(stod(item));
+        } catch (...) {
+            return false;
+        }
+        if (f.size() == 4) f.insert(f.begin() + 2, RangeStats().secondsPerGuess);
+        if (f.size() == 5) f = {f[0], f[3], f[4], static_cast<double>(lround(f[0])), f[1], f[2], f[4]};
+        if (f.size() != 7) return false;
+        PlayerStats &st = stats_[player];
+        st.level = f[0];
+        st.winRate = f[1];
+        st.games = static_cast<int>(f[2]);
+        RangeStats &range = st.ranges[static_cast<int>(f[3])];
+        range.attemptRatio = f[4];
+        range.secondsPerGuess = f[5];
+        range.games = static_cast<int>(f[6]);
+        return true;
+    }
+
+    void load() {
+        loaded_ = true;
+        ifstream ifs(path_);
+        string line;
+        while (getline(ifs, line))
+            if (apply_row(line)) ++rows_;
+        if (rows_ > 2 * live_rows()) compact();
+    }
+
+    size_t live_rows() const {
+        size_t n = 0;
+        for (auto &entry : stats_) n += entry.second.ranges.size();
+        return n;
+    }
+
+    // Rewrite the file with only the latest row per player and bucket
+    void compact() {
+        string tmp = path_ + ".tmp";
+        ofstream ofs(tmp, ios::trunc);
+        for (auto &entry : stats_)
+            for (auto &range : entry.second.ranges) write_row(ofs, entry.first, entry.second, range.first);
+        ofs.close();
+        if (!ofs || rename(tmp.c_str(), path_.c_str()) != 0) {
+            remove(tmp.c_str());
+            return; // the long file still reads the same
+        }
+        rows_ = live_rows();
+    }
+
+    string path_;
+    bool loaded_ = false;
+    size_t rows_ = 0; // rows in the file, superseded ones included
+    map<string, PlayerStats> stats_;
+};
+
+// ---------- Bot strategies and tournaments ----------
+// A Guesser picks the next guess from the current hint window. Bump
+// version() whenever a strategy's behaviour changes so cached tournament
+// results for it are not reused.
+class Guesser {
+public:
+    virtual ~Guesser() = default;
+    virtual string name() const = 0;
+    virtual int version() const = 0;
+    virtual int64_t next_guess(int64_t low, int64_t high, mt19937_64 &rng) const = 0;
+};
+
+class BisectGuesser : public Guesser {
+public:
+    string name() const override { return "bisect"; }
+    int version() const override { return 1; }
+    int64_t next_guess(int64_t low, int64_t high, mt19937_64 &) const override { return low + (high - low) / 2; }
+};
+
+class GoldenGuesser : public Guesser {
+public:
+    string name() const override { return "golden"; }
+    int version() const override { return 1; }
+    int64_t next_guess(int64_t low, int64_t high, mt19937_64 &) const override {
+        return low + static_cast<int64_t>(static_cast<double>(high - low) * 0.381966);
+    }
+};
+
+class RandomGuesser : public Guesser {
+public:
+    string name() const override { return "random"; }
+    int version() const override { return 1; }
+    int64_t next_guess(int64_t low, int64_t high, mt19937_64 &rng) const override {
+        return uniform_int_distribution<int64_t>(low, high)(rng);
+    }
+};
+
+class QuarterGuesser : public Guesser {
+public:
+    string name() const override { return "quarter"; }
+    int version() const override { return 1; }
+    int64_t next_guess(int64_t low, int64_t high, mt19937_64 &) const override { return low + (high - low) / 4; }
+};
+
+vector<unique_ptr<Guesser>> all_guessers() {
+    vector<unique_ptr<Guesser>> g;
+    g.emplace_back(new BisectGuesser());
+    g.emplace_back(new GoldenGuesser());
+    g.emplace_back(new RandomGuesser());
+    g.emplace_back(new QuarterGuesser());
+    return g;
+}
+
+// Attempts a guesser needs for one seeded game; maxAttempts + 1 if it lost
+int guesser_game(const Guesser &g, const WideGameConfig &cfg, int64_t secret, uint64_t seed) {
+    mt19937_64 rng(seed);
+    GameSession<DynamicRules<int64_t>> session(DynamicRules<int64_t>(cfg), secret);
+    while (true) {
+        if (session.guess(g.next_guess(session.low(), session.high(), rng)) == Verdict::Correct) return session.attempts();
+        if (session.out_of_attempts()) return session.attempts() + 1;
+    }
+}
+
+struct PairingResult {
+    long long winsA = 0, winsB = 0, draws = 0;
+    long long attemptsA = 0, attemptsB = 0;
+};
+
+// Both guessers play the same `games` secrets; fewer attempts wins the game
+PairingResult play_pairing(const Guesser &a, const Guesser &b, const WideGameConfig &cfg, uint64_t seed, int games) {
+    PairingResult r;
+    for (int i = 0; i < games; ++i) {
+        mt19937_64 gameRng(seed ^ (0x9E3779B97F4A7C15ull * static_cast<uint64_t>(i + 1)));
+        int64_t secret = uniform_int_distribution<int64_t>(cfg.minValue, cfg.maxValue)(gameRng);
+        uint64_t botSeed = gameRng();
+        int x = guesser_game(a, cfg, secret, botSeed), y = guesser_game(b, cfg, secret, botSeed);
+        r.attemptsA += x;
+        r.attemptsB += y;
+        if (x < y) r.winsA++;
+        else if (y < x) r.winsB++;
+        else r.draws++;
+    }
+    return r;
+}
+
+const string TOURNAMENT_CACHE_FILE = "tournament_cache.csv";
+
+// Pairing results keyed by strategy versions, seed, config and game count,
+// kept in a CSV so repeated tournaments only play new pairings
+class TournamentCache {
+public:
+    explicit TournamentCache(const string &path) : path_(path) {
+        ifstream ifs(path_);
+        string line;
+        while (getline(ifs, line)) {
+            auto q = line.rfind("\",");
+            if (line.size() < 2 || line.front() != '"' || q == string::npos) continue;
+            PairingResult r;
+            char sep;
+            stringstream ss(line.substr(q + 2));
+            if (ss >> r.winsA >> sep >> r.winsB >> sep >> r.draws >> sep >> r.attemptsA >> sep >> r.attemptsB)
+                entries_[line.substr(1, q - 1)] = r;
+        }
+    }
+
+    static string key(const Guesser &a, const Guesser &b, const WideGameConfig &cfg, uint64_t seed, int games) {
+        stringstream ss;
+        ss << a.name() << "@" << a.version() << " " << b.name() << "@" << b.version() << " seed=" << seed
+           << " " << cfg.minValue << ".." << cfg.maxValue << "/" << cfg.maxAttempts << " games=" << games;
+        return ss.str();
+    }
+
+    bool find(const string &k, PairingResult &out) const {
+        auto it = entries_.find(k);
+        if (it == entries_.end()) return false;
+        out = it->second;
+        return true;
+    }
+
+    void add(const string &k, const PairingResult &r) {
+        entries_[k] = r;
+        ofstream ofs(path_, ios::app);
+        if (ofs) ofs << "\"" << k << "\"," << r.winsA << "," << r.winsB << "," << r.draws << "," << r.attemptsA << "," << r.attemptsB << "\n";
+    }
+
+private:
+    string path_;
+    map<string, PairingResult> entries_;
+};
+
+struct PairingJob {
+    size_t a, b, config;
+    string key;
+    PairingResult result;
+    bool cached = false;
+};
+
+// Play every job that is not cached, sharded across worker threads. Each
+// job writes only its own slot, so results do not depend on scheduling.
+void run_pairings(vector<PairingJob> &jobs, const vector<unique_ptr<Guesser>> &bots,
+                  const vector<WideGameConfig> &configs, uint64_t seed, int games, TournamentCache &cache) {
+    vector<size_t> todo;
+    for (size_t i = 0; i < jobs.size(); ++i) {
+        auto &j = jobs[i];
+        j.key = TournamentCache::key(*bots[j.a], *bots[j.b], configs[j.config], seed, games);
+        j.cached = cache.find(j.key, j.result);
+        if (!j.cached) todo.push_back(i);
+    }
+    atomic<size_t> next{0};
+    auto work = [&] {
+        for (size_t t; (t = next.fetch_add(1)) < todo.size();) {
+            auto &j = jobs[todo[t]];
+            j.result = play_pairing(*bots[j.a], *bots[j.b], configs[j.config], seed, games);
+        }
+    };
+    unsigned n = max(1u, min(thread::hardware_concurrency(), static_cast<unsigned>(todo.size())));
+    vector<thread> threads;
+    for (unsigned i = 1; i < n; ++i) threads.emplace_back(work);
+    work();
+    for (auto &t : threads) t.join();
+    for (size_t i : todo) cache.add(jobs[i].key, jobs[i].result);
+}
+
+struct Standing {
+    string name;
+    double points = 0;  // 1 per game won, 0.5 per draw
+    long long games = 0, attempts = 0;
+    int eliminatedInRound = 0; // bracket only; 0 = champion
+};
+
+void tally(vector<Standing> &table, const PairingJob &j) {
+    auto &r = j.result;
+    long long n = r.winsA + r.winsB + r.draws;
+    table[j.a].points += r.winsA + 0.5 * r.draws;
+    table[j.b].points += r.winsB + 0.5 * r.draws;
+    table[j.a].games += n;
+    table[j.b].games += n;
+    table[j.a].attempts += r.attemptsA;
+    table[j.b].attempts += r.attemptsB;
+}
+
+// --tournament round-robin|bracket: every strategy against every other on
+// each catalog preset without lies, `games` seeded games per pairing
+int run_tournament(const string &format, const PresetCatalog &catalog, int games, uint64_t seed, const string &reportPath) {
+    if (format != "round-robin" && format != "bracket") {
+        cerr << "Unknown tournament format: " << format << " (use round-robin or bracket)\n";
+        return 2;
+    }
+    auto bots = all_guessers();
+    vector<WideGameConfig> configs;
+    for (auto &p : catalog.presets()) if (p.maxLies == 0) configs.push_back(p);
+    if (configs.empty()) { cerr << "No presets without lies to play on.\n"; return 2; }
+
+    TournamentCache cache(TOURNAMENT_CACHE_FILE);
+    vector<Standing> table(bots.size());
+    for (size_t i = 0; i < bots.size(); ++i) table[i].name = bots[i]->name();
+    size_t played = 0, reused = 0;
+    auto start = Clock::now();
+
+    auto play_round = [&](const vector<pair<size_t, size_t>> &pairs) {
+        vector<PairingJob> jobs;
+        for (auto &p : pairs)
+            for (size_t c = 0; c < configs.size(); ++c) jobs.push_back({p.first, p.second, c, "", {}, false});
+        run_pairings(jobs, bots, configs, seed, games, cache);
+        for (auto &j : jobs) { tally(table, j); (j.cached ? reused : played)++; }
+        return jobs;
+    };
+
+    if (format == "round-robin") {
+        vector<pair<size_t, size_t>> pairs;
+        for (size_t a = 0; a < bots.size(); ++a)
+            for (size_t b = a + 1; b < bots.size(); ++b) pairs.push_back({a, b});
+        play_round(pairs);
+    } else {
+        vector<size_t> alive(bots.size());
+        for (size_t i = 0; i < alive.size(); ++i) alive[i] = i;
+        for (int round = 1; alive.size() > 1; ++round) {
+            vector<pair<size_t, size_t>> pairs;
+            for (size_t i = 0; i + 1 < alive.size(); i += 2) pairs.push_back({alive[i], alive[i + 1]});
+            auto jobs = play_round(pairs);
+            vector<size_t> next;
+            for (auto &p : pairs) {
+                long long a = 0, b = 0, attA = 0, attB = 0;
+                for (auto &j : jobs)
+                    if (j.a == p.first && j.b == p.second) {
+                        a += j.result.winsA; b += j.result.winsB;
+                        attA += j.result.attemptsA; attB += j.result.attemptsB;
+                    }
+                bool firstWins = a != b ? a > b : attA <= attB;
+                next.push_back(firstWins ? p.first : p.second);
+                table[firstWins ? p.second : p.first].eliminatedInRound = round;
+            }
+            if (alive.size() % 2) next.push_back(alive.back()); // bye
+            alive.swap(next);
+        }
+    }
+    double secs = chrono::duration<double>(Clock::now() - start).count();
+
+    vector<Standing> ranked = table;
+    stable_sort(ranked.begin(), ranked.end(), [&](const Standing &x, const Standing &y) {
+        if (format == "bracket" && x.eliminatedInRound != y.eliminatedInRound)
+            return x.eliminatedInRound == 0 || (y.eliminatedInRound != 0 && x.eliminatedInRound > y.eliminatedInRound);
+        if (x.points != y.points) return x.points > y.points;
+        return x.name < y.name;
+    });
+
+    ConsoleWriter report;
+    report << "Tournament: " << format << ", " << games << " games per pairing and preset, seed " << seed << "\n";
+    TextTable standings({{"Rank", 6}, {"Strategy", 12}, {"Points", 12}, {"Games", 10}, {"Win%", 10}, {"Att", 10}});
+    for (size_t i = 0; i < ranked.size(); ++i) {
+        auto &st = ranked[i];
+        double winPct = st.games ? 100.0 * st.points / st.games : 0.0;
+        double att = st.games ? static_cast<double>(st.attempts) / st.games : 0.0;
+        standings.cell(static_cast<int64_t>(i + 1)).cell(st.name).cell(st.points, 1)
+                 .cell(static_cast<int64_t>(st.games)).cell(winPct, 1).cell(att, 2);
+    }
+    standings.render(report, 60);
+    report << played << " pairings played, " << reused << " reused from cache, ";
+    report.fixed(secs, 2) << " s\n";
+
+    if (!reportPath.empty()) {
+        ofstream ofs(reportPath);
+        if (ofs) ofs << report.str();
+        else cerr << "Warning: could not write " << reportPath << "\n";
+    }
+    report.flush();
+    return 0;
+}
+
+// ---------- Result queue ----------
+// Bounded lock-free multi-producer single-consumer queue carrying finished
+// games from game threads to the one thread that persists them. Slots are
+// allocated up front and Results are moved in and out, so a push or pop
+// never allocates. Each slot has a sequence number (Vyukov's bounded queue):
+// producers claim a position with a CAS on tail_, fill the slot, then
+// publish it by setting its sequence; the consumer reads slots in order.
+//
+// When the queue is full, the Backpressure policy decides what push does:
+// Block waits for the consumer, Drop discards the result and counts it, and
+// Spill appends it to a side file (same CSV format as the leaderboard) so
+// nothing is lost while game threads keep going.
+enum class Backpressure { Block, Drop, Spill };
+
+class ResultQueue {
+public:
+    ResultQueue(size_t capacity, Backpressure policy, const string &spillPath = "")
+        : policy_(policy), spillPath_(spillPath) {
+        size_t size = 2;
+        while (size < capacity) size *= 2;
+        mask_ = size - 1;
+        slots_.reset(new Slot[size]);
+        for (size_t i = 0; i < size; ++i) slots_[i].seq.store(i, memory_order_relaxed);
+    }
+
+    // Producer side. Returns false if the result was dropped or spilled.
+    bool push(Result &&r) {
+        for (unsigned spins = 0;; ++spins) {
+            size_t pos = tail_.load(memory_order_relaxed);
+            Slot &slot = slots_[pos & mask_];
+            size_t seq = slot.seq.load(memory_order_acquire);
+            if (seq == pos) {
+                if (tail_.compare_exchange_weak(pos, pos + 1, memory_order_relaxed)) {
+                    slot.value = move(r);
+                    slot.seq.store(pos + 1, memory_order_release);
+                    return true;
+                }
+            } else if (seq < pos) {
+                // full: the consumer has not freed this slot yet
+                if (policy_ == Backpressure::Drop) { dropped_.fetch_add(1, memory_order_relaxed); return false; }
+                if (policy_ == Backpressure::Spill) { spill(r); return false; }
+                if (spins > 16) this_thread::yield();
+            }
+        }
+    }
+
+    // Consumer side (one thread only). Returns false if the queue is empty.
+    bool pop(Result &out) {
+        Slot &slot = slots_[head_ & mask_];
+        if (slot.seq.load(memory_order_acquire) != head_ + 1) return false;
+        out = move(slot.value);
+        slot.seq.store(head_ + mask_ + 1, memory_order_release);
+        ++head_;
+        return true;
+    }
+
+    uint64_t dropped() const { return dropped_.load(memory_order_relaxed); }
+    uint64_t spilled() const { return spilled_.load(memory_order_relaxed); }
+
+private:
+    struct Slot {
+        atomic<size_t> seq;
+        Result value;
+    };
+
+    void spill(const Result &r) {
+        lock_guard<mutex> lock(spillMutex_);
+        ofstream ofs(spillPath_, ios::app);
+        if (ofs) write_leaderboard_row(ofs, r);
+        else cerr << "Warning: could not write spill file " << spillPath_ << "\n";
+        spilled_.fetch_add(1, memory_order_relaxed);
+    }
+
+    Backpressure policy_;
+    string spillPath_;
+    unique_ptr<Slot[]> slots_;
+    size_t mask_;
+    alignas(64) atomic<size_t> tail_{0};
+    alignas(64) size_t head_ = 0;
+    atomic<uint64_t> dropped_{0}, spilled_{0};
+    mutex spillMutex_;
+};
+
+// The single consumer: drains a ResultQueue into the leaderboard on its own
+// thread until stopped, then empties whatever is left. `onBatch`, if set,
+// sees each drained batch after it has been written.
+class ResultWriter {
+public:
+    using BatchHandler = function<void(const vector<Result> &)>;
+
+    // persist saves each batch, by default with one leaderboard file write;
+    // onBatch sees it afterwards
+    explicit ResultWriter(ResultQueue &queue, BatchHandler onBatch = nullptr, BatchHandler persist = nullptr)
+        : queue_(queue), onBatch_(move(onBatch)), persist_(move(persist)), thread_([this] { run(); }) {}
+    ~ResultWriter() {
+        stop_.store(true);
+        thread_.join();
+    }
+
+private:
+    void run() {
+        vector<Result> batch;
+        Result r;
+        while (true) {
+            bool stopping = stop_.load();
+            batch.clear();
+            while (batch.size() < MAX_BATCH && queue_.pop(r)) batch.push_back(move(r));
+            if (!batch.empty()) {
+                if (persist_) persist_(batch);
+                else if (!append_to_leaderboard(batch)) log_line("Warning: could not write leaderboard file.", cerr);
+                if (onBatch_) onBatch_(batch);
+            }
+            if (stopping && batch.empty()) return;
+            if (batch.empty()) this_thread::sleep_for(chrono::milliseconds(2));
+        }
+    }
+
+    static constexpr size_t MAX_BATCH = 256;
+
+    ResultQueue &queue_;
+    BatchHandler onBatch_, persist_;
+    atomic<bool> stop_{false};
+    thread thread_;
+};
+
+// ---------- Published snapshots ----------
+// RCU-style publication for data with one writer and a fixed set of reader
+// threads. The writer swaps in a new immutable version; readers announce the
+// epoch they start in, load the current pointer and use it, all without
+// waiting. A replaced version is freed once every reader is idle or has
+// announced a later epoch, so no reader can still be looking at it.
+template <typename T>
+class EpochPublished {
+public:
+    EpochPublished(int readers, unique_ptr<T> initial)
+        : current_(initial.release()), slots_(new ReaderSlot[readers]), readers_(readers) {}
+
+    ~EpochPublished() {
+        delete current_.load();
+        for (auto &r : retired_) delete r.second;
+    }
+
+    // Reader side: wait-free. Keep the guard only while using the data.
+    class Guard {
+    public:
+        Guard(atomic<uint64_t> &slot, const T *data) : slot_(slot), data_(data) {}
+        Guard(const Guard &) = delete;
+        Guard &operator=(const Guard &) = delete;
+        ~Guard() { slot_.store(IDLE); }
+        const T &operator*() const { return *data_; }
+        const T *operator->() const { return data_; }
+
+    private:
+        atomic<uint64_t> &slot_;
+        const T *data_;
+    };
+
+    Guard read(int reader) {
+        atomic<uint64_t> &slot = slots_[reader].epoch;
+        slot.store(epoch_.load());
+        return Guard(slot, current_.load());
+    }
+
+    // Writer side (one thread): the latest version, to build the next from
+    const T &latest() const { return *current_.load(); }
+
+    void publish(unique_ptr<T> next) {
+        T *old = current_.exchange(next.release());
+        uint64_t e = epoch_.fetch_add(1); // readers announcing > e see the new version
+        retired_.push_back({e, old});
+        reclaim();
+    }
+
+private:
+    static constexpr uint64_t IDLE = numeric_limits<uint64_t>::max();
+
+    struct alignas(64) ReaderSlot {
+        atomic<uint64_t> epoch{IDLE};
+    };
+
+    void reclaim() {
+        uint64_t oldest = IDLE;
+        for (int i = 0; i < readers_; ++i) oldest = min(oldest, slots_[i].epoch.load());
+        auto keep = remove_if(retired_.begin(), retired_.end(), [&](const pair<uint64_t, T *> &r) {
+            if (oldest <= r.first) return false;
+            delete r.second;
+            return true;
+        });
+        retired_.erase(keep, retired_.end());
+    }
+
+    atomic<T *> current_;
+    atomic<uint64_t> epoch_{1};
+    unique_ptr<ReaderSlot[]> slots_;
+    int readers_;
+    vector<pair<uint64_t, T *>> retired_; // (epoch at retirement, version)
+};
+
+// Mutex + deque baseline for --bench-queue
+class LockedResultQueue {
+public:
+    bool push(Result &&r) { lock_guard<mutex> lock(m_); q_.push_back(move(r)); return true; }
+    bool pop(Result &out) {
+        lock_guard<mutex> lock(m_);
+        if (q_.empty()) return false;
+        out = move(q_.front());
+        q_.pop_front();
+        return true;
+    }
+
+private:
+    mutex m_;
+    deque<Result> q_;
+};
+
+template <typename Queue>
+double bench_queue(Queue &q, int producers, int perProducer) {
+    atomic<bool> go{false};
+    vector<thread> threads;
+    for (int p = 0; p < producers; ++p)
+        threads.emplace_back([&, p] {
+            while (!go.load()) this_thread::yield();
+            for (int i = 0; i < perProducer; ++i) {
+                Result r;
+                r.playerName = "bot";
+                r.attempts = p;
+                r.secretNumber = i;
+                q.push(move(r));
+            }
+        });
+    auto start = Clock::now();
+    go.store(true);
+    long long total = static_cast<long long>(producers) * perProducer, got = 0;
+    Result r;
+    while (got < total) {
+        if (q.pop(r)) ++got;
+        else this_thread::yield();
+    }
+    double secs = chrono::duration<double>(Clock::now() - start).count();
+    for (auto &t : threads) t.join();
+    return total / secs / 1e6;
+}
+
+void run_queue_benchmark(int producers) {
+    const int perProducer = 500000;
+    cout << producers << " producers x " << perProducer << " results, one consumer\n";
+    ResultQueue lockFree(4096, Backpressure::Block);
+    LockedResultQueue locked;
+    double a = bench_queue(lockFree, producers, perProducer);
+    double b = bench_queue(locked, producers, perProducer);
+    ConsoleWriter out;
+    out << "  lock-free MPSC (block): ";
+    out.fixed(a, 2) << " M results/s\n";
+    out << "  mutex + deque:          ";
+    out.fixed(b, 2) << " M results/s\n";
+}
+
+// ---------- Simulator ----------
+// Binary-search bot games played straight through GameSession, timing the
+// compile-time preset rules against the runtime rules for the same config.
+template <typename Rules>
+int bot_game(const Rules &rules, typename Rules::value_type secret, double &score) {
+    GameSession<Rules> session(rules, secret);
+    while (true) {
+        auto low = session.low(), high = session.high();
+        if (session.guess(low + (high - low) / 2) == Verdict::Correct || session.out_of_attempts()) break;
+    }
+    score = session.score(0.0);
+    return session.attempts();
+}
+
+template <typename Rules>
+void bench_rules(TextTable &table, const string &label, const Rules &rules,
+                 const vector<typename Rules::value_type> &secrets) {
+    double totalScore = 0, score = 0;
+    long long totalAttempts = 0;
+    auto start = Clock::now();
+    for (auto secret : secrets) {
+        totalAttempts += bot_game(rules, secret, score);
+        totalScore += score;
+    }
+    double ns = chrono::duration<double, nano>(Clock::now() - start).count() / secrets.size();
+    table.cell(label).cell(ns, 1).cell(static_cast<double>(totalAttempts) / secrets.size(), 2)
+        .cell(totalScore / secrets.size(), 2);
+}
+
+template <typename Rules>
+void bench_preset(TextTable &table, const string &name, int games) {
+    vector<int> secrets(games);
+    for (auto &s : secrets) s = random_int(Rules::min_value(), Rules::max_value());
+    bench_rules(table, name + " (constexpr)", Rules(), secrets);
+    bench_rules(table, name + " (runtime)", DynamicRules<int>(GameConfig(preset_config<Rules>(name))), secrets);
+}
+
+void run_simulation(int games) {
+    ConsoleWriter out;
+    out << "Simulating " << games << " binary-search games per preset\n";
+    out.flush();
+    TextTable table({{"Rules", 22}, {"ns/game", 10}, {"Att", 10}, {"Score", 10}});
+    bench_preset<EasyRules>(table, "Easy", games);
+    bench_preset<MediumRules>(table, "Medium", games);
+    bench_preset<HardRules>(table, "Hard", games);
+    table.render(out, 52);
+}
+
+// ---------- Timer wheel ----------
+// Hierarchical timing wheel for per-session deadlines: LEVELS wheels of
+// SLOTS buckets, where each level's bucket spans a whole turn of the level
+// below. A timer sits in the coarsest bucket that still resolves its
+// deadline and drops a level each time that bucket comes due. Timers are
+// intrusive list nodes, so arm, cancel and expiry are O(1) each.
+struct TimerNode {
+    TimerNode *prev = nullptr, *next = nullptr;
+    uint64_t expires = 0;   // in ticks
+    uint64_t owner = 0;     // e.g. a connection id
+    int kind = 0;
+
+    bool armed() const { return prev != nullptr; }
+};
+
+class TimerWheel {
+public:
+    static constexpr int LEVELS = 4;
+    static constexpr int BITS = 6;
+    static constexpr uint64_t SLOTS = uint64_t(1) << BITS;
+
+    explicit TimerWheel(uint64_t nowTick) : now_(nowTick) {
+        for (auto &level : wheel_)
+            for (auto &head : level) head.prev = head.next = &head;
+    }
+
+    void arm(TimerNode &t, uint64_t expiresTick) {
+        if (t.armed()) unlink(t);
+        else ++count_;
+        t.expires = max(expiresTick, now_ + 1);
+        place(t);
+    }
+
+    void cancel(TimerNode &t) {
+        if (!t.armed()) return;
+        unlink(t);
+        --count_;
+    }
+
+    size_t size() const { return count_; }
+    uint64_t now() const { return now_; }
+
+    // Run every timer due at or before `nowTick`. onExpire gets the node
+    // after it has been disarmed, so it may re-arm it or free its owner.
+    template <typename F>
+    void advance(uint64_t nowTick, F onExpire) {
+        while (now_ < nowTick) {
+            ++now_;
+            // cascade coarser buckets that come due at this tick
+            for (int level = 1; level < LEVELS; ++level) {
+                if (now_ & ((uint64_t(1) << (BITS * level)) - 1)) break;
+                TimerNode &head = wheel_[level][(now_ >> (BITS * level)) & (SLOTS - 1)];
+                while (head.next != &head) {
+                    TimerNode &t = *head.next;
+                    unlink(t);
+                    place(t);
+                }
+            }
+            TimerNode &head = wheel_[0][now_ & (SLOTS - 1)];
+            while (head.next != &head) {
+                TimerNode &t = *head.next;
+                unlink(t);
+                --count_;
+                onExpire(t);
+            }
+            if (count_ == 0) now_ = nowTick; // nothing armed: skip the idle ticks
+        }
+    }
+
+private:
+    void place(TimerNode &t) {
+        uint64_t delta = t.expires - now_;
+        int level = 0;
+        while (level < LEVELS - 1 && delta >= (uint64_t(1) << (BITS * (level + 1)))) ++level;
+        uint64_t when = t.expires;
+        // beyond the top level's reach: park in its furthest bucket and re-place on cascade
+        uint64_t reach = uint64_t(1) << (BITS * LEVELS);
+        if (delta >= reach) when = now_ + reach - 1;
+        TimerNode &head = wheel_[level][(when >> (BITS * level)) & (SLOTS - 1)];
+        t.prev = head.prev;
+        t.next = &head;
+        head.prev->next = &t;
+        head.prev = &t;
+    }
+
+    static void unlink(TimerNode &t) {
+        t.prev->next = t.next;
+        t.next->prev = t.prev;
+        t.prev = t.next = nullptr;
+    }
+
+    TimerNode wheel_[LEVELS][SLOTS];
+    uint64_t now_;
+    size_t count_ = 0;
+};
+
+// ---------- Session table ----------
+// Live sessions by 64-bit id, shared by many worker threads. Ids hash to
+// one of SHARDS small open-addressing tables (linear probing, at most half
+// full), each with its own lock on its own cache line, so threads working
+// on different sessions rarely meet. Values live in per-shard slabs: their
+// addresses never change and there is no allocation per session.
+template <typename V>
+class SessionTable {
+public:
+    static constexpr size_t SHARDS = 64;
+
+    SessionTable() = default;
+    SessionTable(const SessionTable &) = delete;
+    SessionTable &operator=(const SessionTable &) = delete;
+
+    ~SessionTable() {
+        for (auto &sh : shards_)
+            for (auto &slot : sh.slots)
+                if (slot.key > TOMBSTONE) slot.value->~V();
+    }
+
+    // Ids 0 and 1 are reserved for empty and deleted slots
+    static bool valid_id(uint64_t id) { return id > TOMBSTONE; }
+
+    // False if the id is taken
+    bool insert(uint64_t id, V value) {
+        Shard &sh = shard_for(id);
+        lock_guard<mutex> lock(sh.lock);
+        if (find_slot(sh, id)) return false;
+        if ((sh.size + sh.tombstones + 1) * 2 > sh.slots.size()) rehash(sh);
+        Slot *slot = free_slot(sh, id);
+        if (slot->key == TOMBSTONE) --sh.tombstones;
+        slot->key = id;
+        slot->value = new (sh.allocate()) V(move(value));
+        ++sh.size;
+        return true;
+    }
+
+    // Runs f(V&) under the shard lock; false if the id is unknown
+    template <typename F>
+    bool with(uint64_t id, F f) {
+        Shard &sh = shard_for(id);
+        lock_guard<mutex> lock(sh.lock);
+        Slot *slot = find_slot(sh, id);
+        if (!slot) return false;
+        f(*slot->value);
+        return true;
+    }
+
+    // Runs f(V&) and removes the session, in one step
+    template <typename F>
+    bool take(uint64_t id, F f) {
+        Shard &sh = shard_for(id);
+        lock_guard<mutex> lock(sh.lock);
+        Slot *slot = find_slot(sh, id);
+        if (!slot) return false;
+        f(*slot->value);
+        remove(sh, *slot);
+        return true;
+    }
+
+    bool erase(uint64_t id) {
+        return take(id, [](V &) {});
+    }
+
+    // Visits every session one shard at a time, removing those where
+    // pred(id, V&) is true
+    template <typename P>
+    void erase_if(P pred) {
+        for (auto &sh : shards_) {
+            lock_guard<mutex> lock(sh.lock);
+            for (auto &slot : sh.slots)
+                if (slot.key > TOMBSTONE && pred(slot.key, *slot.value)) remove(sh, slot);
+        }
+    }
+
+    // Visits every session one shard at a time
+    template <typename F>
+    void for_each(F f) {
+        for (auto &sh : shards_) {
+            lock_guard<mutex> lock(sh.lock);
+            for (auto &slot : sh.slots)
+                if (slot.key > TOMBSTONE) f(slot.key, *slot.value);
+        }
+    }
+
+    size_t size() const {
+        size_t n = 0;
+        for (auto &sh : shards_) {
+            lock_guard<mutex> lock(sh.lock);
+            n += sh.size;
+        }
+        return n;
+    }
+
+private:
+    static constexpr uint64_t EMPTY = 0, TOMBSTONE = 1;
+    static constexpr size_t SLAB_CHUNK = 256;
+
+    struct Slot {
+        uint64_t key = EMPTY;
+        V *value = nullptr;
+    };
+
+    union Node {
+        Node *nextFree;
+        typename aligned_storage<sizeof(V), alignof(V)>::type storage;
+    };
+
+    struct alignas(64) Shard {
+        mutable mutex lock;
+        vector<Slot> slots = vector<Slot>(16);
+        size_t size = 0, tombstones = 0;
+        vector<unique_ptr<Node[]>> chunks;
+        Node *freeList = nullptr;
+
+        void *allocate() {
+            if (!freeList) {
+                chunks.emplace_back(new Node[SLAB_CHUNK]);
+                Node *chunk = chunks.back().get();
+                for (size_t i = 0; i < SLAB_CHUNK; ++i) chunk[i].nextFree = i + 1 < SLAB_CHUNK ? &chunk[i + 1] : nullptr;
+                freeList = chunk;
+            }
+            Node *n = freeList;
+            freeList = n->nextFree;
+            return &n->storage;
+        }
+
+        void release(V *v) {
+            Node *n = reinterpret_cast<Node *>(v);
+            n->nextFree = freeList;
+            freeList = n;
+        }
+    };
+
+    // splitmix64 finaliser: sequential or clustered ids still spread evenly
+    static uint64_t mix(uint64_t x) {
+        x ^= x >> 30;
+        x *= 0xbf58476d1ce4e5b9ULL;
+        x ^= x >> 27;
+        x *= 0x94d049bb133111ebULL;
+        return x ^ (x >> 31);
+    }
+
+    Shard &shard_for(uint64_t id) { return shards_[mix(id) >> 58]; } // top 6 bits pick one of 64
+
+    static Slot *find_slot(Shard &sh, uint64_t id) {
+        size_t mask = sh.slots.size() - 1;
+        for (size_t i = mix(id) & mask;; i = (i + 1) & mask) {
+            Slot &slot = sh.slots[i];
+            if (slot.key == id) return &slot;
+            if (slot.key == EMPTY) return nullptr;
+        }
+    }
+
+    static Slot *free_slot(Shard &sh, uint64_t id) {
+        size_t mask = sh.slots.size() - 1;
+        size_t i = mix(id) & mask;
+        while (sh.slots[i].key > TOMBSTONE) i = (i + 1) & mask;
+        return &sh.slots[i];
+    }
+
+    // Doubles the table, or just clears tombstones if they are what filled it
+    static void rehash(Shard &sh) {
+        size_t capacity = sh.slots.size();
+        if ((sh.size + 1) * 4 > capacity) capacity *= 2;
+        vector<Slot> old(capacity);
+        old.swap(sh.slots);
+        sh.tombstones = 0;
+        for (auto &slot : old)
+            if (slot.key > TOMBSTONE) *free_slot(sh, slot.key) = slot;
+    }
+
+    static void remove(Shard &sh, Slot &slot) {
+        slot.value->~V();
+        sh.release(slot.value);
+        slot.key = TOMBSTONE;
+        slot.value = nullptr;
+        --sh.size;
+        ++sh.tombstones;
+    }
+
+    Shard shards_[SHARDS];
+};
+
+// Lookup latency as the table fills, then throughput with every core
+// guessing at once
+void run_session_benchmark(int sessions) {
+    using Session = GameSession<DynamicRules<int64_t>>;
+    WideGameConfig cfg = preset_config<MediumRules>("Medium");
+    SessionTable<Session> table;
+    vector<uint64_t> ids;
+    ids.reserve(static_cast<size_t>(sessions));
+    mt19937_64 gen(42);
+    const int lookups = 1000000;
+    ConsoleWriter out;
+    out << "Session table, up to " << sessions << " live sessions\n";
+    out.flush();
+    for (int size = 1000;; size = min(size * 10, sessions)) {
+        while (static_cast<int>(ids.size()) < size) {
+            uint64_t id = gen();
+            if (!SessionTable<Session>::valid_id(id) || !table.insert(id, Session(DynamicRules<int64_t>(cfg), 50))) continue;
+            ids.push_back(id);
+        }
+        auto start = Clock::now();
+        volatile int64_t sink = 0;
+        for (int i = 0; i < lookups; ++i)
+            table.with(ids[gen() % ids.size()], [&](Session &s) { sink = s.high(); });
+        double ns = chrono::duration<double, nano>(Clock::now() - start).count() / lookups;
+        out << "  ";
+        out.pad_left(to_string(size), 8) << " sessions: ";
+        out.fixed(ns, 1) << " ns per lookup\n";
+        out.flush(); // one line per table size as it finishes
+        if (size == sessions) break;
+    }
+
+    int threads = static_cast<int>(max(1u, thread::hardware_concurrency()));
+    vector<thread> pool;
+    auto start = Clock::now();
+    for (int t = 0; t < threads; ++t)
+        pool.emplace_back([&, t] {
+            mt19937_64 local(static_cast<uint64_t>(t));
+            for (int i = 0; i < lookups; ++i)
+                table.with(ids[local() % ids.size()], [&](Session &s) { s.guess(static_cast<int64_t>(local() % 100) + 1); });
+        });
+    for (auto &th : pool) th.join();
+    double secs = chrono::duration<double>(Clock::now() - start).count();
+    out << "  " << threads << " threads guessing: ";
+    out.fixed(threads * static_cast<double>(lookups) / secs / 1e6, 2) << " M guesses/s\n";
+}
+
+// ---------- I/O backends ----------
+// The server does its socket and leaderboard I/O either the classic way,
+// one read/send/write call per operation after epoll says a descriptor is
+// ready, or through an io_uring: operations are queued on a submission ring
+// and a whole batch goes to the kernel in one io_uring_enter, copying to and
+// from buffers registered with the ring once up front. The ring is optional
+// and picked at startup; Auto falls back to Classic where the kernel (or a
+// seccomp policy) refuses io_uring_setup.
+enum class IoBackend { Auto, Classic, Uring };
+
+// Syscalls made for server I/O, to compare the backends per game played
+struct IoStats {
+    atomic<uint64_t> syscalls{0};
+    atomic<uint64_t> games{0};
+    atomic<uint64_t> leaderboardFailures{0}; // batches not (fully) saved
+};
+
+IoStats &io_stats() {
+    static IoStats stats;
+    return stats;
+}
+
+template <typename R>
+R counted(R result) {
+    io_stats().syscalls.fetch_add(1, memory_order_relaxed);
+    return result;
+}
+
+#ifdef __linux__
+#ifdef HAVE_IO_URING
+// Minimal io_uring over the raw syscalls (no liburing): fixed-buffer reads
+// and writes, submitted and reaped in batches by one thread
+class IoRing {
+public:
+    explicit IoRing(unsigned entries) {
+        io_uring_params p{};
+        fd_ = static_cast<int>(syscall(__NR_io_uring_setup, entries, &p));
+        if (fd_ < 0) return;
+        sqRingSize_ = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+        cqRingSize_ = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+        if (p.features & IORING_FEAT_SINGLE_MMAP) sqRingSize_ = cqRingSize_ = max(sqRingSize_, cqRingSize_);
+        sqRing_ = mmap(nullptr, sqRingSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_SQ_RING);
+        cqRing_ = (p.features & IORING_FEAT_SINGLE_MMAP)
+                      ? sqRing_
+                      : mmap(nullptr, cqRingSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_CQ_RING);
+        sqesSize_ = p.sq_entries * sizeof(io_uring_sqe);
+        void *sqes = mmap(nullptr, sqesSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_SQES);
+        if (sqRing_ == MAP_FAILED || cqRing_ == MAP_FAILED || sqes == MAP_FAILED ||
+            !(p.features & IORING_FEAT_RW_CUR_POS)) {
+            close_ring();
+            return;
+        }
+        char *sq = static_cast<char *>(sqRing_), *cq = static_cast<char *>(cqRing_);
+        sqHead_ = reinterpret_cast<unsigned *>(sq + p.sq_off.head);
+        sqTail_ = reinterpret_cast<unsigned *>(sq + p.sq_off.tail);
+        sqMask_ = *reinterpret_cast<unsigned *>(sq + p.sq_off.ring_mask);
+        sqArray_ = reinterpret_cast<unsigned *>(sq + p.sq_off.array);
+        sqes_ = static_cast<io_uring_sqe *>(sqes);
+        sqEntries_ = p.sq_entries;
+        cqHead_ = reinterpret_cast<unsigned *>(cq + p.cq_off.head);
+        cqTail_ = reinterpret_cast<unsigned *>(cq + p.cq_off.tail);
+        cqMask_ = *reinterpret_cast<unsigned *>(cq + p.cq_off.ring_mask);
+        cqes_ = reinterpret_cast<io_uring_cqe *>(cq + p.cq_off.cqes);
+    }
+
+    IoRing(const IoRing &) = delete;
+    IoRing &operator=(const IoRing &) = delete;
+    ~IoRing() { close_ring(); }
+
+    bool ok() const { return fd_ >= 0; }
+
+    bool register_buffers(const iovec *buffers, unsigned count) {
+        return ok() && counted(syscall(__NR_io_uring_register, fd_, IORING_REGISTER_BUFFERS, buffers, count)) == 0;
+    }
+
+    // Queue a read into / write from registered buffer `index` at the file's
+    // current position (append-only files and sockets). False when the
+    // submission ring is full.
+    bool read_fixed(int fd, void *buf, unsigned len, int index, uint64_t tag) {
+        return queue(IORING_OP_READ_FIXED, fd, buf, len, index, tag);
+    }
+    bool write_fixed(int fd, const void *buf, unsigned len, int index, uint64_t tag) {
+        return queue(IORING_OP_WRITE_FIXED, fd, buf, len, index, tag);
+    }
+
+    // Submits everything queued in one call and waits for all of it;
+    // onComplete(tag, result) sees each result (bytes, or -errno). Never
+    // returns with completions outstanding: they would be reaped later
+    // under the next batch's tags. Running short of kernel resources only
+    // retries; any other failure of io_uring_enter leaves the ring in an
+    // unknown state and aborts the process.
+    template <typename F>
+    void submit_and_wait(F onComplete) {
+        unsigned waiting = queued_;
+        unsigned toSubmit = queued_;
+        queued_ = 0;
+        while (waiting > 0) {
+            int n = static_cast<int>(
+                counted(syscall(__NR_io_uring_enter, fd_, toSubmit, waiting, IORING_ENTER_GETEVENTS, nullptr, 0)));
+            bool retry = n < 0 && (errno == EAGAIN || errno == EBUSY || errno == ENOMEM);
+            if (n < 0 && errno != EINTR && !retry) {
+                log_line("io_uring_enter failed with " + to_string(waiting) + " operations outstanding: " +
+                         strerror(errno), cerr);
+                abort();
+            }
+            if (n > 0) toSubmit -= min(toSubmit, static_cast<unsigned>(n));
+            if (retry && *cqHead_ == __atomic_load_n(cqTail_, __ATOMIC_ACQUIRE))
+                this_thread::sleep_for(chrono::milliseconds(1));
+            unsigned head = *cqHead_;
+            while (head != __atomic_load_n(cqTail_, __ATOMIC_ACQUIRE)) {
+                const io_uring_cqe &cqe = cqes_[head & cqMask_];
+                onComplete(cqe.user_data, cqe.res);
+                ++head;
+                --waiting;
+            }
+            __atomic_store_n(cqHead_, head, __ATOMIC_RELEASE);
+        }
+    }
+
+private:
+    bool queue(uint8_t op, int fd, const void *buf, unsigned len, int index, uint64_t tag) {
+        unsigned tail = *sqTail_;
+        if (tail - __atomic_load_n(sqHead_, __ATOMIC_ACQUIRE) >= sqEntries_) return false;
+        unsigned slot = tail & sqMask_;
+        io_uring_sqe &sqe = sqes_[slot];
+        memset(&sqe, 0, sizeof sqe);
+        sqe.opcode = op;
+        sqe.fd = fd;
+        sqe.off = static_cast<uint64_t>(-1); // current position
+        sqe.addr = reinterpret_cast<uint64_t>(buf);
+        sqe.len = len;
+        sqe.buf_index = static_cast<uint16_t>(index);
+        sqe.user_data = tag;
+        sqArray_[slot] = slot;
+        __atomic_store_n(sqTail_, tail + 1, __ATOMIC_RELEASE);
+        ++queued_;
+        return true;
+    }
+
+    void close_ring() {
+        if (sqRing_ && sqRing_ != MAP_FAILED) munmap(sqRing_, sqRingSize_);
+        if (cqRing_ && cqRing_ != MAP_FAILED && cqRing_ != sqRing_) munmap(cqRing_, cqRingSize_);
+        if (sqes_) munmap(sqes_, sqesSize_);
+        if (fd_ >= 0) ::close(fd_);
+        fd_ = -1;
+        sqRing_ = cqRing_ = nullptr;
+        sqes_ = nullptr;
+    }
+
+    int fd_ = -1;
+    void *sqRing_ = nullptr, *cqRing_ = nullptr;
+    size_t sqRingSize_ = 0, cqRingSize_ = 0, sqesSize_ = 0;
+    unsigned *sqHead_ = nullptr, *sqTail_ = nullptr, *sqArray_ = nullptr, sqMask_ = 0, sqEntries_ = 0;
+    unsigned *cqHead_ = nullptr, *cqTail_ = nullptr, cqMask_ = 0;
+    io_uring_sqe *sqes_ = nullptr;
+    io_uring_cqe *cqes_ = nullptr;
+    unsigned queued_ = 0;
+};
+#else
+// Built without the io_uring headers: no ring is ever available
+class IoRing {
+public:
+    explicit IoRing(unsigned) {}
+    bool ok() const { return false; }
+    bool register_buffers(const iovec *, unsigned) { return false; }
+    bool read_fixed(int, void *, unsigned, int, uint64_t) { return false; }
+    bool write_fixed(int, const void *, unsigned, int, uint64_t) { return false; }
+    template <typename F>
+    void submit_and_wait(F) {}
+};
+#endif
+
+// An io_uring with `slots` registered buffers of `slotSize` bytes, or
+// nothing if the backend is Classic or io_uring is unavailable
+class RegisteredRing {
+public:
+    RegisteredRing(IoBackend backend, unsigned slots, unsigned slotSize) : slotSize_(slotSize) {
+        if (backend == IoBackend::Classic) return;
+        ring_.reset(new IoRing(slots * 2));
+        buffers_.assign(static_cast<size_t>(slots) * slotSize, 0);
+        vector<iovec> iov(slots);
+        for (unsigned i = 0; i < slots; ++i) iov[i] = {slot(i), slotSize};
+        if (!ring_->ok() || !ring_->register_buffers(iov.data(), slots)) {
+            ring_.reset();
+            buffers_.clear();
+        }
+    }
+
+    explicit operator bool() const { return ring_ != nullptr; }
+    IoRing &ring() { return *ring_; }
+    char *slot(unsigned i) { return &buffers_[static_cast<size_t>(i) * slotSize_]; }
+    unsigned slots() const { return static_cast<unsigned>(buffers_.size() / slotSize_); }
+    unsigned slot_size() const { return slotSize_; }
+
+private:
+    unique_ptr<IoRing> ring_;
+    vector<char> buffers_;
+    unsigned slotSize_;
+};
+
+// Appends result batches to the leaderboard file with one write per batch,
+// keeping the file open in between
+class LeaderboardSink {
+public:
+    explicit LeaderboardSink(IoBackend backend) : io_(backend, 1, 64 * 1024) {
+        fd_ = ::open(LEADERBOARD_FILE.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+        openError_ = fd_ < 0 ? errno : 0;
+    }
+    LeaderboardSink(const LeaderboardSink &) = delete;
+    LeaderboardSink &operator=(const LeaderboardSink &) = delete;
+    ~LeaderboardSink() {
+        if (fd_ >= 0) ::close(fd_);
+    }
+
+    bool uses_ring() const { return static_cast<bool>(io_); }
+
+    void append(const vector<Result> &batch) {
+        string data;
+        for (auto &r : batch) append_leaderboard_row(data, r);
+        CsvStamp before = leaderboard_stamp();
+        int error = fd_ < 0 ? openError_ : io_ ? write_ring(data) : write_plain(data);
+        if (error) {
+            io_stats().leaderboardFailures.fetch_add(1, memory_order_relaxed);
+            log_line("Warning: could not write leaderboard file (" + string(strerror(error)) + "); " +
+                     to_string(batch.size()) + " results not saved", cerr);
+        }
+        publish_to_shared_leaderboard(batch, before);
+    }
+
+private:
+    // Consecutive writes that made no progress (EAGAIN or 0 bytes) before
+    // giving up, a millisecond apart
+    static constexpr int MAX_STALLS = 100;
+
+    // Short and interrupted writes are resumed until every byte is out.
+    // Each returns 0, or the errno that stopped it.
+    int write_plain(const string &data) {
+        int stalls = 0;
+        for (size_t done = 0; done < data.size();) {
+            ssize_t n = counted(::write(fd_, data.data() + done, data.size() - done));
+            if (int error = progress(n < 0 ? -errno : n, done, stalls))
+                return error;
+        }
+        return 0;
+    }
+
+    // A batch bigger than the buffer goes out one submission per chunk, so
+    // the chunks cannot be reordered
+    int write_ring(const string &data) {
+        int stalls = 0;
+        for (size_t done = 0; done < data.size();) {
+            unsigned len = static_cast<unsigned>(min<size_t>(io_.slot_size(), data.size() - done));
+            memcpy(io_.slot(0), data.data() + done, len);
+            io_.ring().write_fixed(fd_, io_.slot(0), len, 0, 0);
+            int res = 0;
+            io_.ring().submit_and_wait([&](uint64_t, int r) { res = r; });
+            if (int error = progress(res, done, stalls)) return error;
+        }
+        return 0;
+    }
+
+    // Accounts for one write that returned `res` (bytes, or -errno); 0 to
+    // carry on, else the error to give up with
+    static int progress(ssize_t res, size_t &done, int &stalls) {
+        if (res > 0) {
+            done += static_cast<size_t>(res);
+            stalls = 0;
+            return 0;
+        }
+        if (res == -EINTR) return 0;
+        if (res < 0 && res != -EAGAIN && res != -EWOULDBLOCK) return static_cast<int>(-res);
+        if (++stalls > MAX_STALLS) return res < 0 ? static_cast<int>(-res) : EIO;
+        this_thread::sleep_for(chrono::milliseconds(1));
+        return 0;
+    }
+
+    RegisteredRing io_;
+    int fd_;
+    int openError_;
+};
+#endif
+
+// ---------- Rate limiting ----------
+// Token buckets whose whole state (last refill time and tokens left) is one
+// atomic word, so several threads can draw from the same bucket without a
+// lock. Tokens are counted in thousandths, and time in milliseconds.
+class TokenBucket {
+public:
+    static constexpr int64_t MAX_BURST = 1000; // tokens that fit in TOKEN_BITS
+
+    // perSecond 0 means unlimited
+    void configure(double perSecond, double burst) {
+        perMs_ = max(0.0, perSecond);                   // thousandths per ms == tokens per second
+        capacity_ = static_cast<uint64_t>(min<double>(max(1.0, burst), MAX_BURST) * 1000);
+        state_.store(capacity_);
+    }
+
+    bool take(int64_t nowMs) { return update(nowMs, -1000); }
+    void give_back(int64_t nowMs) { update(nowMs, 1000); }
+
+    // How long until take() can succeed
+    int64_t ms_until_token(int64_t nowMs) const {
+        if (perMs_ <= 0) return 0;
+        uint64_t s = state_.load(memory_order_relaxed);
+        double tokens = static_cast<double>(refilled(s, nowMs));
+        return tokens >= 1000 ? 0 : static_cast<int64_t>(ceil((1000 - tokens) / perMs_));
+    }
+
+private:
+    static constexpr int TOKEN_BITS = 20;
+    static constexpr uint64_t TOKEN_MASK = (uint64_t(1) << TOKEN_BITS) - 1;
+
+    uint64_t refilled(uint64_t s, int64_t nowMs) const {
+        int64_t last = static_cast<int64_t>(s >> TOKEN_BITS);
+        uint64_t tokens = s & TOKEN_MASK;
+        if (nowMs > last) tokens = min<uint64_t>(capacity_, tokens + static_cast<uint64_t>((nowMs - last) * perMs_));
+        return tokens;
+    }
+
+    bool update(int64_t nowMs, int64_t delta) {
+        if (perMs_ <= 0) return true;
+        uint64_t s = state_.load(memory_order_relaxed);
+        while (true) {
+            int64_t last = max(static_cast<int64_t>(s >> TOKEN_BITS), nowMs);
+            int64_t tokens = static_cast<int64_t>(refilled(s, nowMs)) + delta;
+            if (tokens < 0) return false;
+            uint64_t next = (static_cast<uint64_t>(last) << TOKEN_BITS) | min<uint64_t>(capacity_, static_cast<uint64_t>(tokens));
+            if (state_.compare_exchange_weak(s, next, memory_order_relaxed)) return true;
+        }
+    }
+
+    double perMs_ = 0;
+    uint64_t capacity_ = 0;
+    atomic<uint64_t> state_{0};
+};
+
+// One bucket per client address, shared by all workers. Addresses claim
+// slots with a CAS and keep them; once the probe window around an address
+// is full, it shares the limit of the slot it hashes to.
+class AddressLimiter {
+public:
+    AddressLimiter(double perSecond, double burst) : slots_(new Slot[SLOTS]) {
+        for (size_t i = 0; i < SLOTS; ++i) slots_[i].bucket.configure(perSecond, burst);
+    }
+
+    TokenBucket &bucket_for(uint32_t addr) {
+        size_t h = static_cast<size_t>(addr * 0x9E3779B1u) & (SLOTS - 1);
+        for (size_t p = 0; p < PROBES; ++p) {
+            Slot &slot = slots_[(h + p) & (SLOTS - 1)];
+            uint32_t owner = slot.addr.load(memory_order_acquire);
+            if (owner == addr) return slot.bucket;
+            if (owner == 0 && (slot.addr.compare_exchange_strong(owner, addr) || owner == addr)) return slot.bucket;
+        }
+        return slots_[h].bucket;
+    }
+
+private:
+    static constexpr size_t SLOTS = 4096, PROBES = 8;
+
+    struct Slot {
+        atomic<uint32_t> addr{0};  // 0.0.0.0 never connects, so 0 means free
+        TokenBucket bucket;
+    };
+
+    unique_ptr<Slot[]> slots_;
+};
+
+// ---------- Resumable scripts ----------
+// A conversation that waits on the network is written top to bottom as a
+// script that suspends until the event it needs arrives. Built as C++20,
+// a script is a real coroutine: Script<Event> owns the frame, and
+// `co_await Script<Event>::until(kinds...)` suspends until resume() is
+// handed an event of one of those kinds, then yields it. Frames come from
+// the owner's FrameSlab, so starting a script does not touch the heap once
+// the slab has warmed up.
+#ifdef HAVE_COROUTINES
+// Coroutine frames, recycled in fixed-size blocks: one free list per
+// GRAIN-sized class, carved from chunks of SLAB_CHUNK blocks like the
+// session table's slabs. Each block starts with a pointer back to its slab,
+// since a frame's operator delete gets no arguments to find it by. Not
+// thread-safe; each race worker has its own.
+class FrameSlab {
+public:
+    static constexpr size_t GRAIN = 64;
+    static constexpr size_t MAX_BLOCK = 4096; // bigger frames go to the heap
+    static constexpr size_t SLAB_CHUNK = 64;
+
+    FrameSlab() = default;
+    FrameSlab(const FrameSlab &) = delete;
+    FrameSlab &operator=(const FrameSlab &) = delete;
+
+    void *allocate(size_t n) {
+        size_t total = n + sizeof(Header);
+        Header *h;
+        if (total > MAX_BLOCK) {
+            h = static_cast<Header *>(::operator new(total));
+            h->slab = nullptr;
+            return h + 1;
+        }
+        Block *&freeList = free_[(total - 1) / GRAIN];
+        if (!freeList) freeList = carve((total - 1) / GRAIN);
+        Block *b = freeList;
+        freeList = b->nextFree;
+        h = reinterpret_cast<Header *>(b);
+        h->slab = this;
+        return h + 1;
+    }
+
+    static void release(void *p, size_t n) {
+        Header *h = static_cast<Header *>(p) - 1;
+        FrameSlab *slab = h->slab;
+        if (!slab) {
+            ::operator delete(h);
+            return;
+        }
+        Block *b = reinterpret_cast<Block *>(h);
+        Block *&freeList = slab->free_[(n + sizeof(Header) - 1) / GRAIN];
+        b->nextFree = freeList;
+        freeList = b;
+    }
+
+private:
+    struct alignas(alignof(max_align_t)) Header {
+        FrameSlab *slab;
+    };
+    struct Block {
+        Block *nextFree;
+    };
+
+    // A new chunk of blocks of class `cls`, linked into a free list
+    Block *carve(size_t cls) {
+        size_t size = (cls + 1) * GRAIN;
+        chunks_.emplace_back(new char[size * SLAB_CHUNK]);
+        char *chunk = chunks_.back().get();
+        for (size_t i = 0; i < SLAB_CHUNK; ++i)
+            reinterpret_cast<Block *>(chunk + i * size)->nextFree =
+                i + 1 < SLAB_CHUNK ? reinterpret_cast<Block *>(chunk + (i + 1) * size) : nullptr;
+        return reinterpret_cast<Block *>(chunk);
+    }
+
+    array<Block *, MAX_BLOCK / GRAIN> free_{};
+    vector<unique_ptr<char[]>> chunks_;
+};
+
+// Event needs a `kind` enum below 32, which until() takes a mask of
+template <typename Event>
+class Script {
+public:
+    struct promise_type {
+        const Event *event = nullptr;
+        uint32_t waitingFor = 0; // one bit per kind
+
+        // Scripts are member coroutines of an owner with a frames() slab
+        template <typename Owner, typename... Args>
+        static void *operator new(size_t n, Owner &owner, Args &&...) { return owner.frames().allocate(n); }
+        static void operator delete(void *p, size_t n) { FrameSlab::release(p, n); }
+
+        Script get_return_object() { return Script(coroutine_handle<promise_type>::from_promise(*this)); }
+        suspend_never initial_suspend() noexcept { return {}; } // runs to its first await at once
+        suspend_always final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { terminate(); }
+    };
+
+    struct Until {
+        uint32_t kinds;
+        promise_type *promise = nullptr;
+
+        bool await_ready() const noexcept { return false; }
+        void await_suspend(coroutine_handle<promise_type> h) noexcept {
+            promise = &h.promise();
+            promise->waitingFor = kinds;
+        }
+        const Event &await_resume() const noexcept { return *promise->event; }
+    };
+
+    template <typename... Kinds>
+    static Until until(Kinds... kinds) { return {((1u << kinds) | ...)}; }
+
+    Script() = default;
+    Script(Script &&o) noexcept : h_(exchange(o.h_, nullptr)) {}
+    Script &operator=(Script &&o) noexcept {
+        if (this != &o) {
+            if (h_) h_.destroy();
+            h_ = exchange(o.h_, nullptr);
+        }
+        return *this;
+    }
+    ~Script() {
+        if (h_) h_.destroy();
+    }
+
+    // Carries on if the script is waiting for this kind of event; the event
+    // only has to outlive this call
+    void resume(const Event &e) {
+        if (!h_ || h_.done() || !((h_.promise().waitingFor >> e.kind) & 1)) return;
+        h_.promise().event = &e;
+        h_.resume();
+    }
+
+private:
+    explicit Script(coroutine_handle<promise_type> h) : h_(h) {}
+
+    coroutine_handle<promise_type> h_;
+};
+#else
+// The C++17 fallback is a protothread: the function switches on where it
+// last suspended and carries on from there, so a suspended script costs one
+// int and awaiting never allocates. It has the usual limits:
+//  - two SCRIPT_AWAITs may not share a source line (the line is the label);
+//  - locals do not survive a suspend, so anything needed afterwards lives in
+//    the caller's object, and no local may be declared across an await;
+//  - the script cannot call a sub-script that suspends, and there is no
+//    frame to pool: all state is in the caller's object.
+#define SCRIPT_BEGIN(point) switch (point) { case 0:
+// Suspends, then resumes each time the script is called until cond holds
+#define SCRIPT_AWAIT(point, cond) \
+    do { point = __LINE__; return; case __LINE__: if (!(cond)) return; } while (0)
+#define SCRIPT_END(point) } point = -1
+#endif
+
+#ifdef __linux__
+// ---------- Race server ----------
+// --serve PORT runs a TCP server where groups of players race to guess one
+// shared secret; any line-based client (nc, telnet) can play. Connections
+// are spread across worker threads, each running its own epoll loop. A
+// match's shared state is only touched through atomics: a total attempt
+// counter, a CAS that decides the winner, and a counter for the finishing
+// positions after that. Workers talk to each other through an inbox
+// drained when their eventfd fires, so once the winner's worker posts the
+// news every player hears it on their worker's next loop iteration.
+struct RaceMatch {
+    uint64_t id = 0;
+    WideGameConfig cfg;
+    int64_t secret = 0;
+    vector<string> names;          // fixed once the match starts
+    atomic<int> attempts{0};       // guesses by all players
+    atomic<int> winner{-1};        // slot of the first correct guesser
+    atomic<int> runnersUp{0};      // correct guessers after the winner
+};
+
+// One player's game in a match. It lives in the server's session table,
+// not on the connection, so a player who drops can resume from any worker.
+struct RaceSession {
+    RaceSession(shared_ptr<RaceMatch> m, int s, string n)
+        : match(move(m)), slot(s), name(move(n)), game(DynamicRules<int64_t>(match->cfg), match->secret),
+          start(Clock::now()) {}
+
+    shared_ptr<RaceMatch> match;
+    int slot;
+    string name;
+    GameSession<DynamicRules<int64_t>> game;
+    Clock::time_point start;
+    uint64_t connId = 0;           // 0 while detached
+    Clock::time_point detachedAt;
+};
+
+struct RaceEvent {
+    enum Kind { Accepted, Started, Won } kind;
+    int fd = -1;                   // Accepted
+    uint64_t connId = 0;           // Started
+    int slot = -1;                 // Started
+    shared_ptr<RaceMatch> match;   // Started, Won
+    uint64_t sessionId = 0;        // Started
+    uint32_t addr = 0;             // Accepted: client IPv4 address
+};
+
+// ---------- Race journal ----------
+// Games in progress survive a server restart: a checkpoint holds every live
+// session, and a write-ahead log holds what happened since. The log is split
+// into numbered segments. A checkpoint first starts a new segment, then copies
+// the session table one shard at a time while play goes on, so it may already
+// include some records of that segment; replay skips anything the restored
+// state has already seen. Older segments are deleted once the checkpoint has
+// been synced. Like the decision tree blobs, records are plain structs
+// written byte for byte.
+constexpr uint32_t CHECKPOINT_MAGIC = 0x4b434352u; // "RCCK"
+const string RACE_CHECKPOINT_FILE = "race.checkpoint";
+const string RACE_LOG_PREFIX = "race.log.";
+
+struct CheckpointHeader {
+    uint32_t magic;
+    uint32_t matchCount;
+    uint64_t sessionCount;
+    uint64_t firstSegment;  // replay the log from here
+    int64_t savedAtMs;
+};
+
+// Followed by `players` JournalNames
+struct JournalMatch {
+    uint64_t id;
+    int64_t minValue, maxValue, secret;
+    int32_t maxAttempts, timeLimitSeconds, scoring, players;
+    int32_t attempts, winner, runnersUp, reserved;
+    char difficulty[32];
+};
+
+struct JournalName {
+    char name[40];
+};
+
+struct JournalSession {
+    uint64_t id, matchId;
+    int32_t slot, attempts;
+    int64_t low, high;
+    int64_t startMs;        // wall clock
+};
+
+// A Match record is followed by a JournalMatch and its names
+struct LogRecord {
+    enum Kind : uint32_t { Match, Start, Guess, End };
+    uint32_t kind;
+    int32_t slot;           // Start, Guess
+    int32_t attempts;       // Guess: the session's count including this one
+    int32_t position;       // Guess: 1 won, 2+ finished later, 0 otherwise
+    uint64_t session;       // Start, Guess, End
+    uint64_t matchId;       // Start, Guess
+    int64_t value;          // Guess
+    int64_t atMs;
+};
+
+int64_t wall_ms() {
+    return chrono::duration_cast<chrono::milliseconds>(chrono::system_clock::now().time_since_epoch()).count();
+}
+
+class RaceJournal {
+public:
+    struct Restored {
+        vector<pair<uint64_t, RaceSession>> sessions;
+        uint64_t lastMatchId = 0;
+        double downtime = 0;    // seconds between the last record and the restart
+    };
+
+    RaceJournal() = default;
+    RaceJournal(const RaceJournal &) = delete;
+    RaceJournal &operator=(const RaceJournal &) = delete;
+    ~RaceJournal() {
+        write_pending();
+        if (fd_ >= 0) ::close(fd_);
+    }
+
+    // Loads the last checkpoint and replays the log on top of it. Restored
+    // games are detached, and their clocks skip the time the server was down.
+    Restored restore() {
+        map<uint64_t, shared_ptr<RaceMatch>> matches;
+        map<uint64_t, pair<RaceSession, int64_t>> sessions; // with wall-clock start
+        int64_t aliveMs = 0;
+
+        string blob = read_file(RACE_CHECKPOINT_FILE);
+        CheckpointHeader h{};
+        size_t pos = 0;
+        if (take(blob, pos, h) && h.magic == CHECKPOINT_MAGIC) {
+            for (uint32_t i = 0; i < h.matchCount; ++i) {
+                shared_ptr<RaceMatch> m = read_match(blob, pos);
+                if (!m) break;
+                matches[m->id] = m;
+            }
+            JournalSession js;
+            for (uint64_t i = 0; i < h.sessionCount && take(blob, pos, js); ++i) {
+                auto m = matches.find(js.matchId);
+                if (m == matches.end() || js.slot < 0 || js.slot >= static_cast<int>(m->second->names.size())) continue;
+                RaceSession session(m->second, js.slot, m->second->names[js.slot]);
+                session.game.restore(js.attempts, js.low, js.high);
+                sessions.emplace(js.id, make_pair(move(session), js.startMs));
+            }
+            first_ = segment_ = h.firstSegment;
+            aliveMs = h.savedAtMs;
+        }
+
+        struct stat st;
+        for (; stat(segment_name(segment_).c_str(), &st) == 0; ++segment_) {
+            string log = read_file(segment_name(segment_));
+            LogRecord r;
+            for (size_t at = 0; take(log, at, r);) {
+                aliveMs = max(aliveMs, r.atMs);
+                if (r.kind == LogRecord::Match) {
+                    shared_ptr<RaceMatch> m = read_match(log, at);
+                    if (!m) break; // torn write at the end of the log
+                    matches.emplace(m->id, m);
+                    continue;
+                }
+                auto s = sessions.find(r.session);
+                if (r.kind == LogRecord::End) {
+                    if (s != sessions.end()) sessions.erase(s);
+                    continue;
+                }
+                auto m = matches.find(r.matchId);
+                if (m == matches.end()) continue;
+                RaceMatch &match = *m->second;
+                if (r.kind == LogRecord::Start) {
+                    if (s == sessions.end() && r.slot >= 0 && r.slot < static_cast<int>(match.names.size()))
+                        sessions.emplace(r.session, make_pair(RaceSession(m->second, r.slot, match.names[r.slot]), r.atMs));
+                    continue;
+                }
+                if (r.position == 1) match.winner = r.slot;
+                if (r.position > 1 && match.runnersUp < r.position - 1) match.runnersUp = r.position - 1;
+                if (s != sessions.end() && s->second.first.game.attempts() < r.attempts) {
+                    s->second.first.game.guess(r.value);
+                    match.attempts.fetch_add(1);
+                }
+            }
+        }
+
+        Restored out;
+        int64_t nowMs = wall_ms();
+        auto now = Clock::now();
+        out.downtime = aliveMs > 0 ? max<int64_t>(0, nowMs - aliveMs) / 1000.0 : 0.0;
+        for (auto &m : matches) out.lastMatchId = max(out.lastMatchId, m.first);
+        for (auto &kv : sessions) {
+            RaceSession &session = kv.second.first;
+            session.start = now - chrono::milliseconds(max<int64_t>(0, aliveMs - kv.second.second));
+            session.detachedAt = now;
+            out.sessions.emplace_back(kv.first, move(session));
+        }
+        lock_guard<mutex> lock(mutex_);
+        open_segment(segment_);
+        dirty_ = !out.sessions.empty() || segment_ != first_;
+        return out;
+    }
+
+    void log_match(const RaceMatch &m) {
+        LogRecord r{LogRecord::Match, -1, 0, 0, 0, m.id, 0, wall_ms()};
+        string rec(reinterpret_cast<const char *>(&r), sizeof r);
+        write_match(rec, m);
+        append(rec);
+    }
+
+    void log_start(uint64_t session, const RaceMatch &m, int slot) {
+        append(LogRecord{LogRecord::Start, slot, 0, 0, session, m.id, 0, wall_ms()});
+    }
+
+    void log_guess(uint64_t session, const RaceMatch &m, int slot, int64_t value, int attempts, int position) {
+        append(LogRecord{LogRecord::Guess, slot, attempts, position, session, m.id, value, wall_ms()});
+    }
+
+    void log_end(uint64_t session) {
+        append(LogRecord{LogRecord::End, -1, 0, 0, session, 0, 0, wall_ms()});
+    }
+
+    // Records are buffered and written together (a group commit): workers
+    // call this before sending replies, so a player never sees the outcome
+    // of a guess that is not in the log yet. A crash tears at most the
+    // last write, which replay ignores.
+    void flush() {
+        lock_guard<mutex> lock(mutex_);
+        write_pending();
+    }
+
+    // Writes a new checkpoint if anything was logged since the last one
+    bool checkpoint(SessionTable<RaceSession> &table) {
+        uint64_t first;
+        {
+            lock_guard<mutex> lock(mutex_);
+            if (!dirty_) return true;
+            write_pending();
+            open_segment(segment_ + 1);
+            first = segment_;
+            dirty_ = false;
+        }
+
+        map<uint64_t, shared_ptr<RaceMatch>> matches;
+        string sessions;
+        uint64_t sessionCount = 0;
+        int64_t nowMs = wall_ms();
+        auto now = Clock::now();
+        table.for_each([&](uint64_t id, const RaceSession &s) {
+            JournalSession js{id, s.match->id, s.slot, s.game.attempts(), s.game.low(), s.game.high(),
+                              nowMs - chrono::duration_cast<chrono::milliseconds>(now - s.start).count()};
+            sessions.append(reinterpret_cast<const char *>(&js), sizeof js);
+            matches.emplace(s.match->id, s.match);
+            ++sessionCount;
+        });
+
+        CheckpointHeader h{CHECKPOINT_MAGIC, static_cast<uint32_t>(matches.size()), sessionCount, first, nowMs};
+        string blob(reinterpret_cast<const char *>(&h), sizeof h);
+        for (auto &m : matches) write_match(blob, *m.second);
+        blob += sessions;
+
+        string tmp = RACE_CHECKPOINT_FILE + ".tmp";
+        int fd = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (fd < 0) return false;
+        bool ok = write_all(fd, blob.data(), blob.size()) && fsync(fd) == 0;
+        ::close(fd);
+        if (!ok || rename(tmp.c_str(), RACE_CHECKPOINT_FILE.c_str()) != 0) return false;
+        for (; first_ < first; ++first_) remove(segment_name(first_).c_str());
+        return true;
+    }
+
+private:
+    static string segment_name(uint64_t segment) { return RACE_LOG_PREFIX + to_string(segment); }
+
+    static string read_file(const string &path) {
+        ifstream in(path, ios::binary);
+        return string(istreambuf_iterator<char>(in), istreambuf_iterator<char>());
+    }
+
+    template <typename R>
+    static bool take(const string &blob, size_t &pos, R &out) {
+        if (blob.size() - pos < sizeof out) return false;
+        memcpy(&out, blob.data() + pos, sizeof out);
+        pos += sizeof out;
+        return true;
+    }
+
+    static void write_match(string &out, const RaceMatch &m) {
+        JournalMatch jm{};
+        jm.id = m.id;
+        jm.minValue = m.cfg.minValue;
+        jm.maxValue = m.cfg.maxValue;
+        jm.secret = m.secret;
+        jm.maxAttempts = m.cfg.maxAttempts;
+        jm.timeLimitSeconds = m.cfg.timeLimitSeconds;
+        jm.scoring = static_cast<int32_t>(m.cfg.scoring);
+        jm.players = static_cast<int32_t>(m.names.size());
+        jm.attempts = m.attempts.load();
+        jm.winner = m.winner.load();
+        jm.runnersUp = m.runnersUp.load();
+        strncpy(jm.difficulty, m.cfg.difficultyName.c_str(), sizeof jm.difficulty - 1);
+        out.append(reinterpret_cast<const char *>(&jm), sizeof jm);
+        for (auto &name : m.names) {
+            JournalName jn{};
+            strncpy(jn.name, name.c_str(), sizeof jn.name - 1);
+            out.append(reinterpret_cast<const char *>(&jn), sizeof jn);
+        }
+    }
+
+    static shared_ptr<RaceMatch> read_match(const string &blob, size_t &pos) {
+        JournalMatch jm;
+        if (!take(blob, pos, jm) || jm.players < 0 || blob.size() - pos < jm.players * sizeof(JournalName)) return nullptr;
+        auto m = make_shared<RaceMatch>();
+        m->id = jm.id;
+        jm.difficulty[sizeof jm.difficulty - 1] = '\0';
+        m->cfg.difficultyName = jm.difficulty;
+        m->cfg.minValue = jm.minValue;
+        m->cfg.maxValue = jm.maxValue;
+        m->cfg.maxAttempts = jm.maxAttempts;
+        m->cfg.timeLimitSeconds = jm.timeLimitSeconds;
+        m->cfg.scoring = static_cast<ScoringPolicy>(jm.scoring);
+        m->secret = jm.secret;
+        m->attempts = jm.attempts;
+        m->winner = jm.winner;
+        m->runnersUp = jm.runnersUp;
+        for (int32_t i = 0; i < jm.players; ++i) {
+            JournalName jn;
+            take(blob, pos, jn);
+            jn.name[sizeof jn.name - 1] = '\0';
+            m->names.push_back(jn.name);
+        }
+        return m;
+    }
+
+    static bool write_all(int fd, const char *data, size_t size) {
+        while (size > 0) {
+            ssize_t n = counted(::write(fd, data, size));
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) return false;
+            data += n;
+            size -= static_cast<size_t>(n);
+        }
+        return true;
+    }
+
+    void open_segment(uint64_t segment) {
+        if (fd_ >= 0) ::close(fd_);
+        segment_ = segment;
+        fd_ = ::open(segment_name(segment).c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    }
+
+    void append(const string &rec) {
+        lock_guard<mutex> lock(mutex_);
+        dirty_ = true;
+        pending_ += rec;
+    }
+
+    void write_pending() {
+        if (fd_ >= 0 && !pending_.empty()) write_all(fd_, pending_.data(), pending_.size());
+        pending_.clear();
+    }
+
+    void append(const LogRecord &r) { append(string(reinterpret_cast<const char *>(&r), sizeof r)); }
+
+    mutex mutex_;
+    string pending_;        // records not yet written
+    int fd_ = -1;
+    uint64_t segment_ = 0;  // being appended to
+    uint64_t first_ = 0;    // oldest segment still on disk
+    bool dirty_ = false;
+};
+
+// Counters for /metrics. Workers bump them with relaxed atomic adds.
+struct ServerMetrics {
+    Clock::time_point started = Clock::now();
+    atomic<int64_t> connections{0};
+    atomic<uint64_t> accepted{0}, lines{0}, throttled{0}, bytesRead{0}, slowDropped{0};
+};
+
+class RaceServer {
+public:
+    // Matches play the `preset` from the catalog current when they start
+    RaceServer(CatalogStore &catalogs, const string &preset, int timeLimitSeconds, int playersPerMatch, int workers,
+               Backpressure backpressure, int idleTimeoutSeconds, IoBackend io, double connRate, double addrRate)
+        : catalogs_(catalogs), preset_(preset), timeLimitSeconds_(timeLimitSeconds), playersPerMatch_(playersPerMatch), idleTimeoutSeconds_(idleTimeoutSeconds), io_(io),
+          connRate_(connRate), addrRate_(addrRate), addrLimits_(addrRate, 2 * addrRate),
+          results_(4096, backpressure, SPILL_FILE),
+          board_(workers, seed_board()) {
+        for (int i = 0; i < workers; ++i) workers_.emplace_back(new Worker(*this, i));
+    }
+
+    int run(int port);
+
+private:
+    // A connection, which is also the frame of its script
+    // What a suspended script is resumed with
+    struct ConnEvent {
+        enum Kind { Opened, Line, Started, TimeUp } kind;
+        const string *line = nullptr;      // Line
+        const RaceEvent *start = nullptr;  // Started
+    };
+
+    struct Conn {
+        enum State { Naming, Waiting, Playing, Done } state = Naming;
+#ifdef HAVE_COROUTINES
+        Script<ConnEvent> script;  // the conversation, suspended
+#else
+        int resumePoint = 0;       // where script() suspended
+#endif
+        int fd;
+        uint64_t id;
+        string in, out, name;
+        shared_ptr<RaceMatch> match;
+        int slot = -1;
+        uint64_t session = 0;      // id in sessions_ while Playing
+        bool queued = false;       // in the worker's list of connections to flush
+        uint32_t interest = 0;     // epoll events registered
+        uint32_t addr = 0;
+        bool throttled = false;    // out of tokens: lines wait and reading stops
+        TokenBucket limiter;
+        TimerNode idleTimer, gameTimer, throttleTimer;
+    };
+
+    enum TimerKind { IdleTimer, GameTimer, SweepTimer, ThrottleTimer };
+    static constexpr int64_t TICK_MS = 100;
+
+    static uint64_t now_tick() {
+        return static_cast<uint64_t>(
+            chrono::duration_cast<chrono::milliseconds>(Clock::now().time_since_epoch()).count() / TICK_MS);
+    }
+
+    // Rate limiter clock
+    int64_t limiter_ms() const {
+        return chrono::duration_cast<chrono::milliseconds>(Clock::now() - metrics_.started).count();
+    }
+
+    // First tick at which `seconds` have surely passed (the current tick is partly gone)
+    static uint64_t deadline_after(double seconds) {
+        return now_tick() + static_cast<uint64_t>(ceil(seconds * 1000 / TICK_MS)) + 1;
+    }
+
+    class Worker {
+    public:
+        Worker(RaceServer &server, int index)
+            : server_(server), index_(index), timers_(now_tick()), io_(server.io_, IO_SLOTS, 4096) {
+            epfd_ = epoll_create1(0);
+            evfd_ = eventfd(0, EFD_NONBLOCK);
+            epoll_event ev{};
+            ev.events = EPOLLIN;
+            ev.data.u64 = 0; // connection ids start at 1
+            epoll_ctl(epfd_, EPOLL_CTL_ADD, evfd_, &ev);
+        }
+
+        void post(RaceEvent e) {
+            {
+                lock_guard<mutex> lock(inboxMutex_);
+                inbox_.push_back(move(e));
+            }
+            uint64_t one = 1;
+            if (counted(write(evfd_, &one, sizeof one)) < 0) { /* counter saturated: already signalled */ }
+        }
+
+        bool uses_ring() const { return static_cast<bool>(io_); }
+
+#ifdef HAVE_COROUTINES
+        FrameSlab &frames() { return frames_; } // for the connection scripts' frames
+#endif
+
+        void loop() {
+            if (index_ == 0 && server_.sessions_.size() > 0) arm_sweep(); // games restored at startup
+            epoll_event events[64];
+            while (true) {
+                // only wake up on the tick while some deadline is pending
+                int n = counted(epoll_wait(epfd_, events, 64, timers_.size() ? static_cast<int>(TICK_MS) : -1));
+                readable_.clear();
+                for (int i = 0; i < n; ++i) {
+                    uint64_t id = events[i].data.u64;
+                    if (id == 0) {
+                        drain_inbox();
+                        continue;
+                    }
+                    auto it = conns_.find(id);
+                    if (it == conns_.end()) continue;
+                    if (events[i].events & EPOLLOUT) queue_flush(it->second);
+                    if (events[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) readable_.push_back(id);
+                }
+                read_ready();
+                timers_.advance(now_tick(), [this](TimerNode &t) { expire(t); });
+                flush_queued();
+            }
+        }
+
+        int index() const { return index_; }
+
+    private:
+        void drain_inbox() {
+            uint64_t count;
+            if (counted(read(evfd_, &count, sizeof count)) < 0) { /* spurious wakeup */ }
+            vector<RaceEvent> events;
+            {
+                lock_guard<mutex> lock(inboxMutex_);
+                events.swap(inbox_);
+            }
+            for (auto &e : events) {
+                if (e.kind == RaceEvent::Accepted) accept_conn(e.fd, e.addr);
+                else if (e.kind == RaceEvent::Started) start_match(e);
+                else announce_winner(*e.match);
+            }
+        }
+
+        void accept_conn(int fd, uint32_t addr) {
+            uint64_t id = server_.nextConnId_.fetch_add(1);
+            Conn &c = conns_[id];
+            c.fd = fd;
+            c.id = id;
+            c.addr = addr;
+            c.limiter.configure(server_.connRate_, 2 * server_.connRate_);
+            c.interest = EPOLLIN | EPOLLRDHUP;
+            epoll_event ev{};
+            ev.events = c.interest;
+            ev.data.u64 = id;
+            counted(epoll_ctl(epfd_, EPOLL_CTL_ADD, fd, &ev));
+            server_.metrics_.accepted.fetch_add(1, memory_order_relaxed);
+            server_.metrics_.connections.fetch_add(1, memory_order_relaxed);
+            c.idleTimer.owner = c.gameTimer.owner = c.throttleTimer.owner = id;
+            c.idleTimer.kind = IdleTimer;
+            c.gameTimer.kind = GameTimer;
+            c.throttleTimer.kind = ThrottleTimer;
+            touch(c);
+            script(c, {ConnEvent::Opened});
+        }
+
+#ifdef HAVE_COROUTINES
+        using ConnScript = Script<ConnEvent>;
+
+        // Opening a connection starts its script; everything else resumes it
+        void script(Conn &c, const ConnEvent &ev) {
+            if (ev.kind == ConnEvent::Opened) c.script = conversation(c);
+            else c.script.resume(ev);
+        }
+
+        // One player's whole conversation with the server, written top to
+        // bottom. Lines, the start of a match and the game timer resume it.
+        ConnScript conversation(Conn &c) {
+            send(c, "Welcome to the number race! Type /board at any time to see the leaderboard.\n"
+                    "Enter your name (or /resume ID to continue a game):\n");
+            while (c.name.empty()) {
+                const ConnEvent &ev = co_await ConnScript::until(ConnEvent::Line);
+                if (ev.line->compare(0, 8, "/resume ") == 0) {
+                    if (!resume(c, strtoull(ev.line->c_str() + 8, nullptr, 10)))
+                        send(c, "No game to resume with that id. Enter your name:\n");
+                } else {
+                    c.name = ev.line->substr(0, 32);
+                    if (c.name.empty()) c.name = "Player" + to_string(c.id);
+                }
+            }
+            while (true) {
+                if (c.state == Conn::Done) co_await ConnScript::until(ConnEvent::Line);
+                if (c.state != Conn::Playing) {
+                    c.state = Conn::Waiting;
+                    send(c, "Waiting for other players...\n");
+                    server_.join_lobby(index_, c.id, c.name);
+                    const ConnEvent &ev = co_await ConnScript::until(ConnEvent::Started);
+                    begin_match(c, *ev.start);
+                }
+                while (c.state == Conn::Playing) {
+                    const ConnEvent &ev = co_await ConnScript::until(ConnEvent::Line, ConnEvent::TimeUp);
+                    if (ev.kind == ConnEvent::TimeUp) {
+                        send(c, "Time's up! The number was " + to_string(c.match->secret) +
+                                ". Send any line to join the next match.\n");
+                        finish(c, 0);
+                    } else {
+                        play_guess(c, *ev.line);
+                    }
+                }
+            }
+        }
+#else
+        // One player's whole conversation with the server, written top to
+        // bottom. Lines, the start of a match and the game timer resume it.
+        void script(Conn &c, const ConnEvent &ev) {
+            SCRIPT_BEGIN(c.resumePoint);
+            send(c, "Welcome to the number race! Type /board at any time to see the leaderboard.\n"
+                    "Enter your name (or /resume ID to continue a game):\n");
+            while (c.name.empty()) {
+                SCRIPT_AWAIT(c.resumePoint, ev.kind == ConnEvent::Line);
+                if (ev.line->compare(0, 8, "/resume ") == 0) {
+                    if (!resume(c, strtoull(ev.line->c_str() + 8, nullptr, 10)))
+                        send(c, "No game to resume with that id. Enter your name:\n");
+                } else {
+                    c.name = ev.line->substr(0, 32);
+                    if (c.name.empty()) c.name = "Player" + to_string(c.id);
+                }
+            }
+            while (true) {
+                if (c.state == Conn::Done) SCRIPT_AWAIT(c.resumePoint, ev.kind == ConnEvent::Line);
+                if (c.state != Conn::Playing) {
+                    c.state = Conn::Waiting;
+                    send(c, "Waiting for other players...\n");
+                    server_.join_lobby(index_, c.id, c.name);
+                    SCRIPT_AWAIT(c.resumePoint, ev.kind == ConnEvent::Started);
+                    begin_match(c, *ev.start);
+                }
+                while (c.state == Conn::Playing) {
+                    SCRIPT_AWAIT(c.resumePoint, ev.kind == ConnEvent::Line || ev.kind == ConnEvent::TimeUp);
+                    if (ev.kind == ConnEvent::TimeUp) {
+                        send(c, "Time's up! The number was " + to_string(c.match->secret) +
+                                ". Send any line to join the next match.\n");
+                        finish(c, 0);
+                    } else {
+                        play_guess(c, *ev.line);
+                    }
+                }
+            }
+            SCRIPT_END(c.resumePoint);
+        }
+#endif
+
+        void start_match(const RaceEvent &e) {
+            auto it = conns_.find(e.connId);
+            if (it == conns_.end()) return; // left while the match was forming
+            script(it->second, {ConnEvent::Started, nullptr, &e});
+        }
+
+        void begin_match(Conn &c, const RaceEvent &e) {
+            c.match = e.match;
+            c.slot = e.slot;
+            c.state = Conn::Playing;
+            c.session = e.sessionId;
+            RaceSession session(e.match, e.slot, c.name);
+            session.connId = c.id;
+            server_.sessions_.insert(e.sessionId, move(session));
+            server_.journal_.log_start(e.sessionId, *e.match, e.slot);
+            int limit = e.match->cfg.timeLimitSeconds;
+            if (limit > 0) timers_.arm(c.gameTimer, deadline_after(limit));
+            ConsoleWriter msg;
+            msg << "Match " << e.match->id << " started with " << e.match->names.size() << " players. "
+                << "Guess a number between " << e.match->cfg.minValue << " and " << e.match->cfg.maxValue;
+            if (e.match->cfg.maxAttempts > 0) msg << " in at most " << e.match->cfg.maxAttempts << " attempts";
+            if (limit > 0) msg << " within " << limit << " seconds";
+            msg << ".\nIf you get disconnected, reconnect and send /resume " << e.sessionId << '\n';
+            send(c, msg.take());
+        }
+
+        void announce_winner(const RaceMatch &m) {
+            int w = m.winner.load();
+            string msg = m.names[w] + " won match " + to_string(m.id) + " after " +
+                         to_string(m.attempts.load()) + " guesses in total.\n";
+            for (auto &kv : conns_)
+                if (kv.second.match.get() == &m && kv.second.slot != w) send(kv.second, msg);
+        }
+
+        // One read per readable connection: epoll is level-triggered, so
+        // whatever is left over is reported again on the next wait. With a
+        // ring, all of them go to the kernel in one call.
+        void read_ready() {
+            if (!io_) {
+                char buf[4096];
+                for (uint64_t id : readable_) {
+                    auto it = conns_.find(id);
+                    if (it == conns_.end()) continue;
+                    ssize_t n = counted(::read(it->second.fd, buf, sizeof buf));
+                    received(id, buf, n < 0 ? -errno : static_cast<int>(n));
+                }
+                return;
+            }
+            for (size_t from = 0; from < readable_.size(); from += IO_SLOTS) {
+                size_t count = min<size_t>(IO_SLOTS, readable_.size() - from);
+                for (size_t i = 0; i < count; ++i) {
+                    auto it = conns_.find(readable_[from + i]);
+                    if (it != conns_.end())
+                        io_.ring().read_fixed(it->second.fd, io_.slot(static_cast<unsigned>(i)), io_.slot_size(),
+                                              static_cast<int>(i), i);
+                }
+                // completions are handled after the whole batch is back, so
+                // a connection closed by one cannot confuse another
+                vector<int> results(count, 0);
+                io_.ring().submit_and_wait([&](uint64_t i, int res) { results[i] = res; });
+                for (size_t i = 0; i < count; ++i)
+                    if (conns_.count(readable_[from + i]))
+                        received(readable_[from + i], io_.slot(static_cast<unsigned>(i)), results[i]);
+            }
+        }
+
+        // n is a byte count, 0 at end of stream, or -errno
+        void received(uint64_t id, const char *buf, int n) {
+            if (n == -EAGAIN || n == -EWOULDBLOCK || n == -EINTR) return;
+            auto it = conns_.find(id);
+            if (it == conns_.end()) return;
+            if (n <= 0) {
+                close_conn(id);
+                return;
+            }
+            Conn &c = it->second;
+            c.in.append(buf, static_cast<size_t>(n));
+            server_.metrics_.bytesRead.fetch_add(static_cast<uint64_t>(n), memory_order_relaxed);
+            process_lines(c);
+        }
+
+        // Handles buffered lines while the client has tokens. A throttled
+        // client's lines wait in c.in, and once that holds MAX_BUFFERED
+        // bytes we stop reading, so the kernel's socket buffer fills and
+        // TCP slows the sender down.
+        void process_lines(Conn &c) {
+            uint64_t id = c.id;
+            size_t nl;
+            while (!c.throttled && (nl = c.in.find('\n')) != string::npos) {
+                if (!admit(c)) break;
+                string line = c.in.substr(0, nl);
+                c.in.erase(0, nl + 1);
+                if (!line.empty() && line.back() == '\r') line.pop_back();
+                handle_line(c, line);
+                if (!conns_.count(id)) return;
+            }
+            if (c.in.size() > MAX_LINE && c.in.find('\n') == string::npos) {
+                close_conn(id); // no newline in sight: not a client of ours
+                return;
+            }
+            update_interest(c);
+        }
+
+        // Takes a token from the connection's bucket and its address's bucket
+        bool admit(Conn &c) {
+            int64_t now = server_.limiter_ms();
+            TokenBucket &shared = server_.addrLimits_.bucket_for(c.addr);
+            if (c.limiter.take(now)) {
+                if (shared.take(now)) {
+                    server_.metrics_.lines.fetch_add(1, memory_order_relaxed);
+                    return true;
+                }
+                c.limiter.give_back(now);
+            }
+            c.throttled = true;
+            server_.metrics_.throttled.fetch_add(1, memory_order_relaxed);
+            int64_t wait = max<int64_t>(1, max(c.limiter.ms_until_token(now), shared.ms_until_token(now)));
+            timers_.arm(c.throttleTimer, deadline_after(wait / 1000.0));
+            return false;
+        }
+
+        void handle_line(Conn &c, const string &line) {
+            touch(c);
+            if (line == "/board") {
+                auto board = server_.board_.read(index_);
+                send(c, render_board(*board));
+                return;
+            }
+            if (line == "/metrics") {
+                send(c, server_.render_metrics());
+                return;
+            }
+            script(c, {ConnEvent::Line, &line});
+        }
+
+        void play_guess(Conn &c, const string &line) {
+            int64_t guess;
+            try {
+                size_t idx = 0;
+                guess = stoll(line, &idx);
+                if (idx != line.size()) throw invalid_argument("extra chars");
+            } catch (...) {
+                send(c, "Please enter an integer.\n");
+                return;
+            }
+            RaceMatch &m = *c.match;
+            Verdict v = Verdict::TooLow;
+            bool outOfAttempts = false;
+            int attempts = 0;
+            bool found = server_.sessions_.with(c.session, [&](RaceSession &s) {
+                v = s.game.guess(guess);
+                outOfAttempts = s.game.out_of_attempts();
+                attempts = s.game.attempts();
+            });
+            if (!found) {
+                // nothing to judge the guess against, so it is neither logged nor answered
+                send(c, "Error: unknown session, this game is no longer running. Send any line to join the next match.\n");
+                finish(c, 0);
+                return;
+            }
+            m.attempts.fetch_add(1, memory_order_relaxed);
+            if (v != Verdict::Correct) {
+                server_.journal_.log_guess(c.session, m, c.slot, guess, attempts, 0);
+                send(c, v == Verdict::TooHigh ? "Too high.\n" : "Too low.\n");
+                if (outOfAttempts) {
+                    send(c, "Out of attempts. Send any line to join the next match.\n");
+                    finish(c, 0);
+                }
+                return;
+            }
+
+            int expected = -1;
+            int position;
+            if (m.winner.compare_exchange_strong(expected, c.slot)) {
+                position = 1;
+                for (auto &w : server_.workers_) w->post({RaceEvent::Won, -1, 0, -1, c.match});
+                send(c, "Correct! You won match " + to_string(m.id) + ".\n");
+            } else {
+                position = 2 + m.runnersUp.fetch_add(1);
+                send(c, "Correct! You finished in position " + to_string(position) + ".\n");
+            }
+            server_.journal_.log_guess(c.session, m, c.slot, guess, attempts, position);
+            send(c, "Send any line to join the next match.\n");
+            finish(c, position);
+        }
+
+        // Ends c's part in its match and records it; position 0 is a loss
+        void finish(Conn &c, int position) {
+            timers_.cancel(c.gameTimer);
+            c.state = Conn::Done;
+            Result r;
+            bool found = server_.sessions_.take(c.session, [&](RaceSession &s) { r = race_result(s, position); });
+            if (found) {
+                server_.journal_.log_end(c.session);
+                server_.results_.push(move(r));
+            }
+            c.session = 0;
+        }
+
+        bool resume(Conn &c, uint64_t id) {
+            bool attached = false;
+            double elapsed = 0;
+            int attempts = 0;
+            int64_t low = 0, high = 0;
+            server_.sessions_.with(id, [&](RaceSession &s) {
+                if (s.connId != 0) return; // still in play on another connection
+                s.connId = c.id;
+                attached = true;
+                c.name = s.name;
+                c.match = s.match;
+                c.slot = s.slot;
+                elapsed = chrono::duration<double>(Clock::now() - s.start).count();
+                attempts = s.game.attempts();
+                low = s.game.low();
+                high = s.game.high();
+            });
+            if (!attached) return false;
+            c.state = Conn::Playing;
+            c.session = id;
+            send(c, "Welcome back, " + c.name + ". Match " + to_string(c.match->id) + ": " + to_string(attempts) +
+                    " guesses so far, the number is between " + to_string(low) + " and " + to_string(high) + ".\n");
+            int limit = c.match->cfg.timeLimitSeconds;
+            if (limit > 0 && elapsed >= limit) {
+                send(c, "Time's up! The number was " + to_string(c.match->secret) +
+                        ". Send any line to join the next match.\n");
+                finish(c, 0);
+            } else if (limit > 0) {
+                timers_.arm(c.gameTimer, deadline_after(limit - elapsed));
+            }
+            return true;
+        }
+
+        // Records and drops sessions whose players have been gone longer than the idle timeout
+        void sweep() {
+            vector<pair<uint64_t, Result>> lost;
+            bool pending = false;
+            auto cutoff = Clock::now() - chrono::seconds(server_.idleTimeoutSeconds_);
+            server_.sessions_.erase_if([&](uint64_t id, RaceSession &s) {
+                if (s.connId != 0) return false;
+                if (s.detachedAt > cutoff) {
+                    pending = true;
+                    return false;
+                }
+                lost.emplace_back(id, race_result(s, 0));
+                return true;
+            });
+            for (auto &l : lost) {
+                server_.journal_.log_end(l.first);
+                server_.results_.push(move(l.second));
+            }
+            if (pending) arm_sweep();
+        }
+
+        void arm_sweep() {
+            if (server_.idleTimeoutSeconds_ > 0 && !sweepTimer_.armed())
+                timers_.arm(sweepTimer_, deadline_after(server_.idleTimeoutSeconds_));
+        }
+
+        // Restarts the idle countdown after any activity
+        void touch(Conn &c) {
+            if (server_.idleTimeoutSeconds_ > 0)
+                timers_.arm(c.idleTimer, deadline_after(server_.idleTimeoutSeconds_));
+        }
+
+        void expire(TimerNode &t) {
+            if (t.kind == SweepTimer) {
+                sweep();
+                return;
+            }
+            auto it = conns_.find(t.owner);
+            if (it == conns_.end()) return;
+            Conn &c = it->second;
+            if (t.kind == ThrottleTimer) {
+                c.throttled = false;
+                process_lines(c);
+                return;
+            }
+            if (t.kind == GameTimer) {
+                script(c, {ConnEvent::TimeUp});
+                return;
+            }
+            if (c.state == Conn::Playing) finish(c, 0);
+            send(c, "Disconnected after " + to_string(server_.idleTimeoutSeconds_) + " seconds of inactivity.\n");
+            close_conn(c.id);
+        }
+
+        // Output is collected and flushed once per loop iteration
+        void send(Conn &c, const string &msg) {
+            c.out += msg;
+            queue_flush(c);
+        }
+
+        void queue_flush(Conn &c) {
+            if (c.queued) return;
+            c.queued = true;
+            flushQueue_.push_back(c.id);
+        }
+
+        void flush_queued() {
+            if (!flushQueue_.empty()) server_.journal_.flush();
+            if (io_) {
+                for (size_t from = 0; from < flushQueue_.size(); from += IO_SLOTS) {
+                    size_t count = min<size_t>(IO_SLOTS, flushQueue_.size() - from);
+                    for (size_t i = 0; i < count; ++i) {
+                        auto it = conns_.find(flushQueue_[from + i]);
+                        if (it == conns_.end() || it->second.out.empty()) continue;
+                        Conn &c = it->second;
+                        unsigned len = static_cast<unsigned>(min<size_t>(io_.slot_size(), c.out.size()));
+                        memcpy(io_.slot(static_cast<unsigned>(i)), c.out.data(), len);
+                        io_.ring().write_fixed(c.fd, io_.slot(static_cast<unsigned>(i)), len, static_cast<int>(i), i);
+                    }
+                    io_.ring().submit_and_wait([&](uint64_t i, int res) {
+                        auto it = conns_.find(flushQueue_[from + i]);
+                        if (it != conns_.end() && res > 0) it->second.out.erase(0, static_cast<size_t>(res));
+                    });
+                }
+            }
+            for (uint64_t id : flushQueue_) {
+                auto it = conns_.find(id);
+                if (it == conns_.end()) continue;
+                Conn &c = it->second;
+                c.queued = false;
+                if (!io_) write_now(c);
+                if (c.out.size() > MAX_OUTPUT) {
+                    // not reading what we send: don't queue for it forever
+                    server_.metrics_.slowDropped.fetch_add(1, memory_order_relaxed);
+                    close_conn(id);
+                    continue;
+                }
+                update_interest(c);
+            }
+            flushQueue_.clear();
+        }
+
+        void write_now(Conn &c) {
+            if (c.out.empty()) return;
+            ssize_t n = counted(::send(c.fd, c.out.data(), c.out.size(), MSG_NOSIGNAL));
+            if (n > 0) c.out.erase(0, static_cast<size_t>(n));
+        }
+
+        // Reads unless throttled with a full input buffer, writes while
+        // output is pending; epoll is only touched when that changes
+        void update_interest(Conn &c) {
+            uint32_t want = (c.throttled && c.in.size() >= MAX_BUFFERED ? 0u : static_cast<uint32_t>(EPOLLIN | EPOLLRDHUP)) |
+                            (c.out.empty() ? 0u : static_cast<uint32_t>(EPOLLOUT));
+            if (c.interest == want) return;
+            c.interest = want;
+            epoll_event ev{};
+            ev.events = want;
+            ev.data.u64 = c.id;
+            counted(epoll_ctl(epfd_, EPOLL_CTL_MOD, c.fd, &ev));
+        }
+
+        void close_conn(uint64_t id) {
+            auto it = conns_.find(id);
+            if (it == conns_.end()) return;
+            if (it->second.state == Conn::Waiting) server_.leave_lobby(id);
+            if (it->second.state == Conn::Playing) {
+                // keep the game for a /resume until the idle timeout reaps it
+                server_.sessions_.with(it->second.session, [](RaceSession &s) {
+                    s.connId = 0;
+                    s.detachedAt = Clock::now();
+                });
+                arm_sweep();
+            }
+            timers_.cancel(it->second.idleTimer);
+            timers_.cancel(it->second.gameTimer);
+            timers_.cancel(it->second.throttleTimer);
+            server_.metrics_.connections.fetch_sub(1, memory_order_relaxed);
+            write_now(it->second); // last words, e.g. the idle timeout notice
+            counted(::close(it->second.fd)); // also drops it from the epoll set
+            conns_.erase(it);
+        }
+
+        static constexpr size_t MAX_LINE = 256;
+        static constexpr size_t MAX_BUFFERED = 1024;       // unread input kept for a throttled client
+        static constexpr size_t MAX_OUTPUT = 64 * 1024;    // unsent output before we give up on a client
+        static constexpr unsigned IO_SLOTS = 64; // one per epoll event
+
+        RaceServer &server_;
+        int index_;
+        int epfd_, evfd_;
+        mutex inboxMutex_;
+        vector<RaceEvent> inbox_;
+#ifdef HAVE_COROUTINES
+        FrameSlab frames_; // before conns_, so it outlives their scripts
+#endif
+        unordered_map<uint64_t, Conn> conns_; // node-based, so Conn's timer nodes never move
+        TimerWheel timers_;
+        TimerNode sweepTimer_{nullptr, nullptr, 0, 0, SweepTimer};
+        RegisteredRing io_;
+        vector<uint64_t> readable_, flushQueue_;
+    };
+
+    static Result race_result(const RaceSession &s, int position) {
+        const RaceMatch &m = *s.match;
+        double elapsed = chrono::duration<double>(Clock::now() - s.start).count();
+        int limit = m.cfg.timeLimitSeconds;
+        if (limit > 0 && elapsed > limit) elapsed = limit;
+        Result r;
+        r.playerName = s.name;
+        r.difficulty = "Race " + difficulty_label(m.cfg);
+        r.attempts = s.game.attempts();
+        r.elapsedSeconds = elapsed;
+        r.secretNumber = m.secret;
+        r.score = position > 0 ? s.game.score(elapsed) : 0.0;
+        r.timestamp = now_iso8601();
+        r.won = position == 1;
+        r.matchId = m.id;
+        r.position = position;
+        return r;
+    }
+
+    struct LobbyEntry { int worker; uint64_t connId; string name; };
+
+    static unique_ptr<BoardData> seed_board() {
+        unique_ptr<BoardData> board(new BoardData());
+        for (auto &r : read_leaderboard(numeric_limits<int>::max())) board->add(board_entry(r));
+        return board;
+    }
+
+    static string render_board(const BoardData &board) {
+        ConsoleWriter out;
+        auto recent = board.recent_games();
+        size_t from = recent.size() > 10 ? recent.size() - 10 : 0;
+        TextTable games({{"Time", 21}, {"Player", 15}, {"Difficulty", 24}, {"Score", 10}});
+        for (size_t i = from; i < recent.size(); ++i)
+            games.cell(recent[i].timestamp).cell(recent[i].player).cell(recent[i].difficulty).cell(recent[i].score, 2);
+        out << "Recent games:\n";
+        games.render(out, 0);
+        TextTable best({{"Difficulty", 24}, {"Player", 15}, {"Score", 10}});
+        for (uint32_t i = 0; i < board.topCount; ++i)
+            best.cell(board.tops[i].difficulty).cell(board.tops[i].entries[0].player).cell(board.tops[i].entries[0].score, 2);
+        out << "Best score per difficulty:\n";
+        best.render(out, 0);
+        return out.take();
+    }
+
+    // Totals plus per-second averages since startup, one "name value" per line
+    string render_metrics() const {
+        double up = max(1e-3, chrono::duration<double>(Clock::now() - metrics_.started).count());
+        auto rate = [up](uint64_t n) { return static_cast<double>(n) / up; };
+        uint64_t lines = metrics_.lines.load(), throttled = metrics_.throttled.load();
+        uint64_t bytes = metrics_.bytesRead.load(), games = io_stats().games.load();
+        ConsoleWriter out;
+        auto value = [&out](string_view name, double v) { out << name << ' '; out.fixed(v, 2) << '\n'; };
+        value("uptime_seconds", up);
+        out << "connections_open " << metrics_.connections.load() << '\n'
+            << "connections_accepted_total " << metrics_.accepted.load() << '\n'
+            << "lines_total " << lines << '\n';
+        value("lines_per_second", rate(lines));
+        out << "throttled_total " << throttled << '\n';
+        value("throttled_per_second", rate(throttled));
+        out << "bytes_read_total " << bytes << '\n';
+        value("bytes_read_per_second", rate(bytes));
+        out << "slow_clients_dropped_total " << metrics_.slowDropped.load() << '\n'
+            << "games_total " << games << '\n';
+        value("games_per_second", rate(games));
+        out << "io_syscalls_total " << io_stats().syscalls.load() << '\n'
+            << "leaderboard_write_failures_total " << io_stats().leaderboardFailures.load() << '\n';
+        value("limit_lines_per_second_per_connection", connRate_);
+        value("limit_lines_per_second_per_address", addrRate_);
+        return out.take();
+    }
+
+    // Runs on the ResultWriter thread, the board's only writer
+    void publish_batch(const vector<Result> &batch) {
+        unique_ptr<BoardData> next(new BoardData(board_.latest()));
+        for (auto &r : batch) next->add(board_entry(r));
+        board_.publish(move(next));
+
+        IoStats &stats = io_stats();
+        uint64_t before = stats.games.fetch_add(batch.size());
+        uint64_t games = before + batch.size();
+        if (games / IO_REPORT_GAMES != before / IO_REPORT_GAMES) {
+            ConsoleWriter out;
+            out << games << " games, ";
+            out.fixed(static_cast<double>(stats.syscalls.load()) / games, 1) << " I/O syscalls per game";
+            log_line(out.take());
+        }
+    }
+
+    // Matches form in the lobby; the last player in starts the match
+    void join_lobby(int worker, uint64_t connId, const string &name) {
+        lock_guard<mutex> lock(lobbyMutex_);
+        lobby_.push_back({worker, connId, name});
+        if (static_cast<int>(lobby_.size()) < playersPerMatch_) return;
+        auto m = make_shared<RaceMatch>();
+        m->id = nextMatchId_++;
+        m->cfg = current_preset();
+        m->secret = random_int(m->cfg.minValue, m->cfg.maxValue);
+        for (auto &e : lobby_) m->names.push_back(e.name);
+        journal_.log_match(*m);
+        for (size_t i = 0; i < lobby_.size(); ++i) {
+            uint64_t session;
+            do session = rng()(); while (!SessionTable<RaceSession>::valid_id(session));
+            workers_[lobby_[i].worker]->post({RaceEvent::Started, -1, lobby_[i].connId, static_cast<int>(i), m, session});
+        }
+        lobby_.clear();
+    }
+
+    // The match settings from this moment's catalog. A preset removed from
+    // the file falls back to the first one, as at startup.
+    WideGameConfig current_preset() const {
+        auto catalog = catalogs_.snapshot();
+        const WideGameConfig *p = catalog->find(preset_);
+        WideGameConfig cfg = p ? *p : catalog->presets().front();
+        cfg.timeLimitSeconds = timeLimitSeconds_;
+        return cfg;
+    }
+
+    void leave_lobby(uint64_t connId) {
+        lock_guard<mutex> lock(lobbyMutex_);
+        lobby_.erase(remove_if(lobby_.begin(), lobby_.end(), [&](const LobbyEntry &e) { return e.connId == connId; }),
+                     lobby_.end());
+    }
+
+    // overflow from results_ under Backpressure::Spill
+    static constexpr const char *SPILL_FILE = "leaderboard.spill.csv";
+    static constexpr int CHECKPOINT_SECONDS = 5;
+    static constexpr uint64_t IO_REPORT_GAMES = 100;
+    static constexpr int CATALOG_POLL_SECONDS = 2;
+
+    CatalogStore &catalogs_;
+    string preset_;
+    int timeLimitSeconds_;      // 0 means no limit
+    int playersPerMatch_;
+    int idleTimeoutSeconds_;    // 0 keeps idle connections forever
+    IoBackend io_;
+    double connRate_, addrRate_; // lines per second; 0 is unlimited
+    AddressLimiter addrLimits_;
+    ServerMetrics metrics_;
+    ResultQueue results_;       // finished games, persisted by one ResultWriter
+    EpochPublished<BoardData> board_; // leaderboard snapshot served by /board, one reader slot per worker
+    SessionTable<RaceSession> sessions_; // every live game, by the session id players resume with
+    RaceJournal journal_;               // checkpoints and logs sessions_ across restarts
+    vector<unique_ptr<Worker>> workers_;
+    atomic<uint64_t> nextConnId_{1};
+    mutex lobbyMutex_;
+    vector<LobbyEntry> lobby_;
+    uint64_t nextMatchId_ = 1;
+};
+
+int RaceServer::run(int port) {
+    int lfd = socket(AF_INET, SOCK_STREAM, 0);
+    if (lfd < 0) { perror("socket"); return 1; }
+    int yes = 1;
+    setsockopt(lfd, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof yes);
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(static_cast<uint16_t>(port));
+    if (::bind(lfd, reinterpret_cast<sockaddr *>(&addr), sizeof addr) < 0 || listen(lfd, 128) < 0) {
+        perror("bind/listen");
+        ::close(lfd);
+        return 1;
+    }
+    signal(SIGPIPE, SIG_IGN);
+    auto restored = journal_.restore();
+    for (auto &s : restored.sessions) sessions_.insert(s.first, move(s.second));
+    nextMatchId_ = max(nextMatchId_, restored.lastMatchId + 1);
+    if (!restored.sessions.empty()) {
+        ConsoleWriter out;
+        out << "Restored " << restored.sessions.size() << " games in progress; their clocks skip the ";
+        out.fixed(restored.downtime, 1) << " seconds the server was down";
+        log_line(out.take());
+    }
+    journal_.checkpoint(sessions_);
+    thread checkpointer([this] {
+        while (true) {
+            this_thread::sleep_for(chrono::seconds(CHECKPOINT_SECONDS));
+            journal_.checkpoint(sessions_);
+        }
+    });
+    // the lobby snapshots the catalog per match, so a reload only affects
+    // matches that start afterwards
+    thread presetWatcher([this] {
+        while (true) {
+            this_thread::sleep_for(chrono::seconds(CATALOG_POLL_SECONDS));
+            if (catalogs_.reload_if_changed())
+                log_line("Reloaded " + catalogs_.path() + "; new matches play " + describe_preset(current_preset()));
+        }
+    });
+
+    LeaderboardSink leaderboard(io_);
+    ConsoleWriter banner;
+    banner << "Race server listening on port " << port << " (" << workers_.size() << " workers, "
+           << playersPerMatch_ << " players per match, " << describe_preset(current_preset()) << ", "
+           << (workers_.front()->uses_ring() && leaderboard.uses_ring() ? "io_uring" : "epoll") << " I/O)";
+    log_line(banner.take());
+    if (io_ == IoBackend::Uring && !(workers_.front()->uses_ring() && leaderboard.uses_ring()))
+        log_line("io_uring is not available here; using epoll and plain writes instead");
+
+    ResultWriter writer(results_, [this](const vector<Result> &batch) { publish_batch(batch); },
+                        [&leaderboard](const vector<Result> &batch) { leaderboard.append(batch); });
+    vector<thread> threads;
+    for (auto &w : workers_) threads.emplace_back([&w] { w->loop(); });
+    size_t next = 0;
+    while (true) {
+        sockaddr_in peer{};
+        socklen_t peerLen = sizeof peer;
+        int fd = counted(accept4(lfd, reinterpret_cast<sockaddr *>(&peer), &peerLen, SOCK_NONBLOCK | SOCK_CLOEXEC));
+        if (fd < 0) continue;
+        workers_[next++ % workers_.size()]->post({RaceEvent::Accepted, fd, 0, -1, nullptr, 0, ntohl(peer.sin_addr.s_addr)});
+    }
+}
+#endif
+
+// ---------- C library interface ----------
+// The extern "C" functions declared in numberGuessing.h. Each one catches
+// everything and answers with an ng_status, never prints, and never reads
+// the terminal. Sessions always run on the 64-bit DynamicRules engine.
+struct ng_config {
+    WideGameConfig cfg;
+};
+
+struct ng_session {
+    ng_session(const WideGameConfig &c, int64_t secret)
+        : cfg(c), game(DynamicRules<int64_t>(c), secret), liesLeft(c.maxLies) {
+        if (c.maxLies > 0) solver.reset(new LieSolver(c.minValue, c.maxValue, c.maxLies));
+    }
+
+    WideGameConfig cfg;
+    GameSession<DynamicRules<int64_t>> game;
+    int liesLeft;
+    unique_ptr<LieSolver> solver;
+    bool won = false;
+
+    bool finished() const { return won || game.out_of_attempts(); }
+};
+
+namespace {
+
+template <typename F>
+ng_status guarded(F body) {
+    try {
+        return body();
+    } catch (const bad_alloc &) {
+        return NG_ERR_NOMEM;
+    } catch (...) {
+        return NG_ERR_INTERNAL;
+    }
+}
+
+// Copy `s` with a terminating NUL; NG_ERR_BUFFER if it had to be cut short
+ng_status copy_out(const string &s, char *buf, size_t size) {
+    if (!buf || size == 0) return NG_ERR_BUFFER;
+    size_t n = min(s.size(), size - 1);
+    memcpy(buf, s.data(), n);
+    buf[n] = '\0';
+    return n == s.size() ? NG_OK : NG_ERR_BUFFER;
+}
+
+// Fixed-size field of an ng_result, which need not be NUL-terminated when full
+template <size_t N>
+string field(const char (&f)[N]) {
+    return string(f, strnlen(f, N));
+}
+
+template <size_t N>
+void set_field(char (&f)[N], const string &s) {
+    size_t n = min(s.size(), N - 1);
+    memcpy(f, s.data(), n);
+    f[n] = '\0';
+}
+
+void to_c_result(const Result &r, ng_result &out) {
+    memset(&out, 0, sizeof out);
+    set_field(out.timestamp, r.timestamp);
+    set_field(out.player, r.playerName);
+    set_field(out.difficulty, r.difficulty);
+    out.attempts = r.attempts;
+    out.elapsed_seconds = r.elapsedSeconds;
+    out.secret = r.secretNumber;
+    out.score = r.score;
+}
+
+ng_status new_config(const WideGameConfig &cfg, ng_config **out) {
+    string error;
+    if (!PresetCatalog::build({cfg}, error)) return NG_ERR_INVALID; // same checks as a preset file
+    *out = new ng_config{cfg};
+    return NG_OK;
+}
+
+// rng() is shared and not thread-safe; hosts may run sessions on any thread
+template <typename T>
+T locked_random(T minv, T maxv) {
+    static mutex rngMutex;
+    lock_guard<mutex> lock(rngMutex);
+    return random_int(minv, maxv);
+}
+
+} // namespace
+
+extern "C" {
+
+int ng_abi_version(void) { return NG_ABI_VERSION; }
+
+ng_status ng_config_preset(const char *presetsPath, const char *name, ng_config **out) {
+    if (!name || !out) return NG_ERR_INVALID;
+    *out = nullptr;
+    return guarded([&] {
+        vector<WideGameConfig> presets;
+        string error;
+        if (presetsPath) {
+            ifstream in(presetsPath);
+            if (!in) return NG_ERR_IO;
+            if (!parse_presets(in, presets, error)) return NG_ERR_INVALID;
+        } else {
+            presets = builtin_presets();
+        }
+        auto catalog = PresetCatalog::build(move(presets), error);
+        if (!catalog) return NG_ERR_INVALID;
+        const WideGameConfig *cfg = catalog->find(name);
+        if (!cfg) return NG_ERR_NOT_FOUND;
+        *out = new ng_config{*cfg};
+        return NG_OK;
+    });
+}
+
+ng_status ng_config_custom(const char *name, int64_t minValue, int64_t maxValue, int maxAttempts, ng_config **out) {
+    if (!out) return NG_ERR_INVALID;
+    *out = nullptr;
+    return guarded([&] {
+        WideGameConfig cfg;
+        if (name) cfg.difficultyName = name;
+        cfg.minValue = minValue;
+        cfg.maxValue = maxValue;
+        cfg.maxAttempts = maxAttempts;
+        return new_config(cfg, out);
+    });
+}
+
+ng_status ng_config_describe(const ng_config *cfg, char *buf, size_t size) {
+    if (!cfg) return NG_ERR_INVALID;
+    return guarded([&] { return copy_out(describe_preset(cfg->cfg), buf, size); });
+}
+
+void ng_config_free(ng_config *cfg) { delete cfg; }
+
+double ng_compute_score(const ng_config *cfg, int attempts, double elapsedSeconds) {
+    if (!cfg || attempts < 1) return 0.0;
+    return compute_score(attempts, elapsedSeconds, cfg->cfg);
+}
+
+ng_status ng_session_new(const ng_config *cfg, ng_session **out) {
+    if (!cfg || !out) return NG_ERR_INVALID;
+    *out = nullptr;
+    return guarded([&] {
+        *out = new ng_session(cfg->cfg, locked_random(cfg->cfg.minValue, cfg->cfg.maxValue));
+        return NG_OK;
+    });
+}
+
+ng_status ng_session_new_with_secret(const ng_config *cfg, int64_t secret, ng_session **out) {
+    if (!cfg || !out) return NG_ERR_INVALID;
+    *out = nullptr;
+    if (secret < cfg->cfg.minValue || secret > cfg->cfg.maxValue) return NG_ERR_INVALID;
+    return guarded([&] {
+        *out = new ng_session(cfg->cfg, secret);
+        return NG_OK;
+    });
+}
+
+// Same rules as play_game, lies included: a Liar session flips some hints
+// and narrows the window to what the solver still considers possible
+ng_status ng_session_guess(ng_session *s, int64_t guess, ng_verdict *out) {
+    if (!s || !out) return NG_ERR_INVALID;
+    if (s->finished()) return NG_ERR_FINISHED;
+    return guarded([&] {
+        Verdict verdict = s->game.guess(guess);
+        if (verdict == Verdict::Correct) {
+            s->won = true;
+            *out = NG_CORRECT;
+            return NG_OK;
+        }
+        bool tooHigh = verdict == Verdict::TooHigh;
+        if (s->solver) {
+            if (s->liesLeft > 0 && locked_random(0, 2) == 0) { tooHigh = !tooHigh; --s->liesLeft; }
+            s->solver->record(guess, tooHigh);
+            s->game.set_window(s->solver->alive_min(), s->solver->alive_max());
+        }
+        *out = tooHigh ? NG_TOO_HIGH : NG_TOO_LOW;
+        return NG_OK;
+    });
+}
+
+int ng_session_attempts(const ng_session *s) { return s ? s->game.attempts() : 0; }
+int ng_session_finished(const ng_session *s) { return s && s->finished(); }
+int ng_session_won(const ng_session *s) { return s && s->won; }
+
+ng_status ng_session_window(const ng_session *s, int64_t *low, int64_t *high) {
+    if (!s || !low || !high) return NG_ERR_INVALID;
+    *low = s->game.low();
+    *high = s->game.high();
+    return NG_OK;
+}
+
+ng_status ng_session_secret(const ng_session *s, int64_t *out) {
+    if (!s || !out) return NG_ERR_INVALID;
+    if (!s->finished()) return NG_ERR_INVALID;
+    *out = s->game.secret();
+    return NG_OK;
+}
+
+ng_status ng_session_result(const ng_session *s, const char *player, double elapsedSeconds, ng_result *out) {
+    if (!s || !out || !s->finished()) return NG_ERR_INVALID;
+    return guarded([&] {
+        Result r;
+        r.playerName = player && *player ? player : "Anonymous";
+        r.difficulty = difficulty_label(s->cfg);
+        r.attempts = s->game.attempts();
+        r.elapsedSeconds = elapsedSeconds;
+        r.secretNumber = s->game.secret();
+        r.timestamp = now_iso8601();
+        r.score = s->won ? s->game.score(elapsedSeconds) : 0.0;
+        to_c_result(r, *out);
+        return NG_OK;
+    });
+}
+
+void ng_session_free(ng_session *s) { delete s; }
+
+ng_status ng_leaderboard_append(const ng_result *r) {
+    if (!r) return NG_ERR_INVALID;
+    return guarded([&] {
+        Result res;
+        res.timestamp = field(r->timestamp);
+        res.playerName = field(r->player);
+        res.difficulty = field(r->difficulty);
+        res.attempts = r->attempts;
+        res.elapsedSeconds = r->elapsed_seconds;
+        res.secretNumber = r->secret;
+        res.score = r->score;
+        return append_to_leaderboard(vector<Result>{res}) ? NG_OK : NG_ERR_IO;
+    });
+}
+
+ng_status ng_leaderboard_recent(ng_result *out, size_t capacity, size_t *count) {
+    if (!count || (capacity > 0 && !out)) return NG_ERR_INVALID;
+    *count = 0;
+    return guarded([&] {
+        vector<Result> rows = read_leaderboard(static_cast<int>(min<size_t>(capacity, numeric_limits<int>::max())));
+        for (auto &r : rows) to_c_result(r, out[(*count)++]);
+        return NG_OK;
+    });
+}
+
+} // extern "C"
+
+// 32-bit ranges take the int instantiation, wider ones the int64_t one
+template <typename T>
+Result play_mode(int mode, const BasicGameConfig<T> &cfg) {
+    return mode == 3 ? play_multi_game(cfg) : play_game(cfg);
+}
+
+#ifndef NG_LIBRARY // the shared library build has no console program
+int main(int argc, char **argv) {
+    ios::sync_with_stdio(false);
+    cin.tie(nullptr);
+
+    bool detectRepeats = false;
+    string presetsFile = PRESETS_FILE, fixedDifficulty;
+    int servePort = 0, racePlayers = 2, timeLimit = 0, idleTimeout = 300;
+    double connRate = 20, addrRate = 100;
+    string tournament, reportPath;
+    int tournamentGames = 1000;
+    Backpressure backpressure = Backpressure::Spill;
+    IoBackend io = IoBackend::Auto;
+    uint64_t tournamentSeed = 42;
+    string sortKey, sortOutput = "leaderboard.sorted.csv";
+    bool sortDescending = false;
+    size_t sortMemoryMB = 64;
+    string groupBy, aggList = "count,mean:score,max:score,p50:seconds,p90:seconds";
+    int reportThreads = static_cast<int>(max(1u, thread::hardware_concurrency()));
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg == "--detect-repeats") detectRepeats = true;
+        else if (arg == "--presets" && i + 1 < argc) presetsFile = argv[++i];
+        else if (arg == "--difficulty" && i + 1 < argc) fixedDifficulty = argv[++i];
+        else if (arg == "--serve" && i + 1 < argc) servePort = atoi(argv[++i]);
+        else if (arg == "--players" && i + 1 < argc) racePlayers = max(1, atoi(argv[++i]));
+        else if (arg == "--time-limit" && i + 1 < argc) timeLimit = max(0, atoi(argv[++i]));
+        else if (arg == "--idle-timeout" && i + 1 < argc) idleTimeout = max(0, atoi(argv[++i]));
+        else if (arg == "--tournament" && i + 1 < argc) tournament = argv[++i];
+        else if (arg == "--games" && i + 1 < argc) tournamentGames = max(1, atoi(argv[++i]));
+        else if (arg == "--seed" && i + 1 < argc) tournamentSeed = strtoull(argv[++i], nullptr, 10);
+        else if (arg == "--report" && i + 1 < argc) reportPath = argv[++i];
+        else if (arg == "--sort" && i + 1 < argc) sortKey = argv[++i];
+        else if (arg == "--desc") sortDescending = true;
+        else if (arg == "--memory" && i + 1 < argc) sortMemoryMB = static_cast<size_t>(max(1, atoi(argv[++i])));
+        else if (arg == "--output" && i + 1 < argc) sortOutput = argv[++i];
+        else if (arg == "--group-by" && i + 1 < argc) groupBy = argv[++i];
+        else if (arg == "--agg" && i + 1 < argc) aggList = argv[++i];
+        else if (arg == "--threads" && i + 1 < argc) reportThreads = max(1, atoi(argv[++i]));
+        else if (arg == "--rate" && i + 1 < argc) connRate = max(0.0, atof(argv[++i]));
+        else if (arg == "--ip-rate" && i + 1 < argc) addrRate = max(0.0, atof(argv[++i]));
+        else if (arg == "--io" && i + 1 < argc) {
+            string backend = argv[++i];
+            if (backend == "auto") io = IoBackend::Auto;
+            else if (backend == "epoll") io = IoBackend::Classic;
+            else if (backend == "uring") io = IoBackend::Uring;
+            else { cerr << "Unknown I/O backend: " << backend << " (use auto, epoll or uring)\n"; return 2; }
+        } else if (arg == "--backpressure" && i + 1 < argc) {
+            string policy = argv[++i];
+            if (policy == "block") backpressure = Backpressure::Block;
+            else if (policy == "drop") backpressure = Backpressure::Drop;
+            else if (policy == "spill") backpressure = Backpressure::Spill;
+            else { cerr << "Unknown backpressure policy: " << policy << " (use block, drop or spill)\n"; return 2; }
+        } else if (arg == "--bench-queue" && i + 1 < argc) {
+            run_queue_benchmark(max(1, atoi(argv[++i])));
+            return 0;
+        }
+        else if (arg == "--bench-sessions" && i + 1 < argc) {
+            run_session_benchmark(max(1000, atoi(argv[++i])));
+            return 0;
+        }
+        else if (arg == "--bench-csv" && i + 1 < argc) {
+            run_csv_benchmark(max(1000, atoi(argv[++i])));
+            return 0;
+        }
+        else if (arg == "--bench-console" && i + 1 < argc) {
+            run_console_benchmark(max(1, atoi(argv[++i])));
+            return 0;
+        }
+        else if (arg == "--watch") {
+#ifdef __linux__
+            return run_watch();
+#else
+            cerr << "Watch mode is only available on Linux.\n";
+            return 2;
+#endif
+        }
+        else if (arg == "--simulate" && i + 1 < argc) {
+            run_simulation(max(1, atoi(argv[++i])));
+            return 0;
+        } else {
+            cerr << "Unknown option: " << arg << "\n";
+            cerr << "Usage: " << argv[0] << " [--detect-repeats] [--presets FILE] [--difficulty NAME] [--time-limit SECONDS] [--simulate GAMES]\n"
+                 << "       " << argv[0] << " --bench-queue PRODUCERS | --bench-sessions SESSIONS | --bench-csv ROWS | --bench-console ROWS | --watch\n"
+                 << "       " << argv[0] << " --serve PORT [--players N] [--backpressure block|drop|spill] [--time-limit SECONDS] [--idle-timeout SECONDS] [--io auto|epoll|uring] [--rate N] [--ip-rate N] [--presets FILE] [--difficulty NAME]\n"
+                 << "       " << argv[0] << " --tournament round-robin|bracket [--games N] [--seed S] [--report FILE]\n"
+                 << "       " << argv[0] << " --sort timestamp|player|difficulty|attempts|seconds|secret|score [--desc] [--memory MB] [--output FILE]\n"
+                 << "       " << argv[0] << " --group-by player|difficulty|day|all [--agg count,sum:F,min:F,max:F,mean:F,pNN:F] [--threads N]\n";
+            return 2;
+        }
+    }
+
+    if (!sortKey.empty()) {
+        SortField field;
+        if (!parse_sort_field(sortKey, field)) {
+            cerr << "Unknown sort key: " << sortKey << "\n";
+            return 2;
+        }
+        return run_external_sort(field, sortDescending, sortMemoryMB << 20, sortOutput);
+    }
+
+    if (!groupBy.empty()) {
+        static const pair<const char *, GroupKey> KEYS[] = {
+            {"player", GroupKey::Player}, {"difficulty", GroupKey::Difficulty}, {"day", GroupKey::Day}, {"all", GroupKey::All}};
+        auto key = find_if(begin(KEYS), end(KEYS), [&](auto &k) { return groupBy == k.first; });
+        vector<AggSpec> specs;
+        string error;
+        if (key == end(KEYS)) error = "unknown group key '" + groupBy + "'";
+        else parse_agg_specs(aggList, specs, error);
+        if (!error.empty()) {
+            cerr << "Invalid report: " << error << "\n";
+            return 2;
+        }
+        return run_group_report(key->second, specs, reportThreads);
+    }
+
+    CatalogStore catalogs(presetsFile);
+    AdaptiveCoach coach(PLAYER_STATS_FILE);
+    if (!fixedDifficulty.empty() && !catalogs.snapshot()->find(fixedDifficulty)) {
+        cerr << "Unknown difficulty: " << fixedDifficulty << "\n";
+        return 2;
+    }
+
+#ifdef __linux__
+    // Attach (and seed from the CSV) before this process appends anything,
+    // so a game finished here is never counted twice
+    SharedLeaderboard::instance();
+#endif
+
+    if (!tournament.empty())
+        return run_tournament(tournament, *catalogs.snapshot(), tournamentGames, tournamentSeed, reportPath);
+
+    if (servePort > 0) {
+#ifdef __linux__
+        int workers = static_cast<int>(max(1u, min(8u, thread::hardware_concurrency())));
+        RaceServer server(catalogs, fixedDifficulty.empty() ? "Medium" : fixedDifficulty, timeLimit, racePlayers, workers,
+                          backpressure, idleTimeout, io, connRate, addrRate);
+        return server.run(servePort);
+#else
+        cerr << "Server mode is only available on Linux.\n";
+        return 2;
+#endif
+    }
+
+    cout << "=== Advanced Number Guessing Game ===\n";
+    cout << "(Type CTRL+D or CTRL+Z to exit any time)\n\n";
+    cout.flush();
+
+    while (true) {
+        int mode = prompt_int("Choose mode:\n"
+                              "  1) You guess my number\n"
+                              "  2) I guess your number\n"
+                              "  3) Find several numbers\n"
+                              "Enter choice [1-3]: ", 1, 3);
+        catalogs.reload_if_changed();
+        auto catalog = catalogs.snapshot(); // this game's view, even if the file changes mid-game
+        WideGameConfig cfg;
+        if (fixedDifficulty.empty()) {
+            cfg = choose_difficulty(*catalog);
+        } else if (auto preset = catalog->find(fixedDifficulty)) {
+            cfg = *preset;
+            cout << "Difficulty: " << describe_preset(cfg) << "\n";
+        } else {
+            cout << "Difficulty '" << fixedDifficulty << "' is no longer in the catalog.\n";
+            cfg = choose_difficulty(*catalog);
+        }
+        if (cfg.adaptive) {
+            string name;
+            while (name.empty()) {
+                cout << "Enter your name (adaptive games are tracked per player): ";
+                cout.flush();
+                name = safe_getline();
+                if (!cin) return 0;
+            }
+            cfg = coach.next_config(name);
+            const PlayerStats &st = coach.stats_for_display(name);
+            const RangeStats &range = st.near(range_bucket(range_size(cfg)));
+            ConsoleWriter out;
+            out << "Range 1 - " << cfg.maxValue << ", " << cfg.maxAttempts << " attempts";
+            if (st.games > 0) {
+                out << " (recent win rate " << static_cast<int>(st.winRate * 100 + 0.5) << "%, ";
+                out.fixed(range.attemptRatio, 2) << "x optimal guesses, ";
+                out.fixed(range.secondsPerGuess, 1) << " s per guess)";
+            }
+            out << '\n';
+        }
+        cfg.detectRepeats = detectRepeats;
+        cfg.timeLimitSeconds = timeLimit;
+        bool narrow = cfg.fits_in<int>();
+        if (mode == 2) {
+            // tree slots are 32-bit offsets with one value reserved for TREE_EMPTY
+            if (narrow && range_size(cfg) < static_cast<double>(TREE_EMPTY)) play_reverse_game(GameConfig(cfg));
+            else cout << "I can only guess numbers from ranges of fewer than 2^32 - 1 values.\n";
+            if (!prompt_yesno("Play again?")) break;
+            cout << "\n";
+            continue;
+        }
+        Result r = narrow ? play_mode(mode, GameConfig(cfg)) : play_mode(mode, cfg);
+        if (cfg.adaptive && mode == 1) coach.record(cfg, r);
+
+        {
+            ConsoleWriter out;
+            out << "\nGame summary:\n";
+            out << " Player: " << r.playerName << '\n';
+            out << " Difficulty: " << r.difficulty << '\n';
+            out << " Attempts: " << r.attempts << '\n';
+            if (detectRepeats) out << " Repeated guesses: " << r.repeats << ", outside range: " << r.outOfWindow << '\n';
+            out << " Time: ";
+            out.fixed(r.elapsedSeconds, 1) << " seconds\n";
+            out << " Score: ";
+            out.fixed(r.score, 2) << "\n";
+        }
+
+        if (prompt_yesno("Would you like to view the recent leaderboard?")) {
+            show_leaderboard(10);
+        }
+
+        if (!prompt_yesno("Play again?")) break;
+        cout << "\n";
+    }
+
+    cout << "Thanks for playing! Goodbye.\n";
+    return 0;
+}
+#endif
@@ -0,0 +1,97 @@
+/*
+ * C interface to the number guessing engine, for hosting games inside
+ * another process (a chat bot, a test harness) without spawning the
+ * console program. Build it as a shared library with:
+ *
+ *   g++ -std=c++17 -O2 -pthread -fPIC -shared -fvisibility=hidden -DNG_LIBRARY \
+ *       -o libnumberguessing.so numberGuessing.cpp
+ *
+ * Objects are opaque handles created and freed by the library. Strings
+ * come back in caller-provided buffers. No call prints, reads the terminal
+ * or lets a C++ exception escape: each one reports failure through its
+ * ng_status. The functions are safe to call from several threads, as long
+ * as one handle is not used by two threads at the same time.
+ *
+ * NG_ABI_VERSION changes whenever a signature or struct layout here does.
+ */
+#ifndef NUMBER_GUESSING_H
+#define NUMBER_GUESSING_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define NG_ABI_VERSION 1
+
+#if defined(_WIN32)
+#define NG_API __declspec(dllexport)
+#else
+#define NG_API __attribute__((visibility("default")))
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+    NG_OK = 0,
+    NG_ERR_INVALID = -1,    /* bad argument, e.g. NULL handle or empty range */
+    NG_ERR_NOT_FOUND = -2,  /* no such preset */
+    NG_ERR_BUFFER = -3,     /* caller's buffer too small; output truncated */
+    NG_ERR_IO = -4,         /* leaderboard or presets file unreadable/unwritable */
+    NG_ERR_NOMEM = -5,
+    NG_ERR_FINISHED = -6,   /* the session is already over */
+    NG_ERR_INTERNAL = -7
+} ng_status;
+
+typedef enum { NG_CORRECT = 0, NG_TOO_HIGH = 1, NG_TOO_LOW = 2 } ng_verdict;
+
+typedef struct ng_config ng_config;
+typedef struct ng_session ng_session;
+
+/* One leaderboard row. The layout is part of the ABI. */
+typedef struct {
+    char timestamp[24];     /* "YYYY-MM-DD HH:MM:SS" */
+    char player[64];
+    char difficulty[64];
+    int32_t attempts;
+    double elapsed_seconds;
+    int64_t secret;
+    double score;
+} ng_result;
+
+NG_API int ng_abi_version(void);
+
+/* Game configuration */
+/* presets_path NULL: the built-in presets; otherwise a presets.cfg-style file */
+NG_API ng_status ng_config_preset(const char *presets_path, const char *name, ng_config **out);
+NG_API ng_status ng_config_custom(const char *name, int64_t min_value, int64_t max_value, int max_attempts,
+                                  ng_config **out);
+NG_API ng_status ng_config_describe(const ng_config *cfg, char *buf, size_t size);
+NG_API void ng_config_free(ng_config *cfg);
+
+/* Score for a game won in `attempts` guesses taking `elapsed_seconds` */
+NG_API double ng_compute_score(const ng_config *cfg, int attempts, double elapsed_seconds);
+
+/* Game session: the engine picks the secret (or the host does, for tests) */
+NG_API ng_status ng_session_new(const ng_config *cfg, ng_session **out);
+NG_API ng_status ng_session_new_with_secret(const ng_config *cfg, int64_t secret, ng_session **out);
+NG_API ng_status ng_session_guess(ng_session *s, int64_t guess, ng_verdict *out);
+NG_API int ng_session_attempts(const ng_session *s);
+NG_API int ng_session_finished(const ng_session *s);   /* won or out of attempts */
+NG_API int ng_session_won(const ng_session *s);
+NG_API ng_status ng_session_window(const ng_session *s, int64_t *low, int64_t *high);
+NG_API ng_status ng_session_secret(const ng_session *s, int64_t *out);  /* only once finished */
+/* Leaderboard row for a finished session; score is 0 for a loss */
+NG_API ng_status ng_session_result(const ng_session *s, const char *player, double elapsed_seconds, ng_result *out);
+NG_API void ng_session_free(ng_session *s);
+
+/* Leaderboard (leaderboard.csv in the current directory) */
+NG_API ng_status ng_leaderboard_append(const ng_result *r);
+/* Copies up to `capacity` of the most recent rows, oldest first; *count gets the number copied */
+NG_API ng_status ng_leaderboard_recent(ng_result *out, size_t capacity, size_t *count);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* NUMBER_GUESSING_H */